@@ -0,0 +1,506 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Benchmark functions.
+
+    `./wox bench` flies the same scripted camera path through a project
+    at a few fixed resolutions with vsync off and reports per frame
+    timings, so builds and driver stacks can be compared like for like.
+    Run it with LIBGL_ALWAYS_SOFTWARE=1 for Mesa llvmpipe.
+
+    `./wox microbench` needs no window, it times the CPU hot paths on a
+    handful of synthetic volumes to give a baseline for optimizations.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_FRAMES 240
+#define BENCH_WARMUP 30
+#define BENCH_SIZES "640x360,1280x720,1920x1080"
+#define BENCH_MAX_SIZES 16
+#define BENCH_INPUT_MS 2 // synthetic input every 2 ms, about a fast mouse
+
+void WOX_POP(const int w, const int h);
+
+typedef struct
+{
+    double min, median, p99, mean; // milliseconds
+}
+bench_stats;
+
+typedef struct
+{
+    uint w, h;
+    bench_stats cpu;   // uniforms and draw submission
+    bench_stats gpu;   // waiting on glFinish() for the draw to complete
+    bench_stats query; // the draw itself, from the GPU timer query
+    bench_stats frame; // the whole frame including the swap
+    uint queries;      // timer query results, 0 without the extension
+    lat_stats latency[LAT_MAX]; // synthetic input to submit and swap
+}
+bench_run;
+
+int benchCmp(const void* a, const void* b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+void benchStats(bench_stats* r, double* v, const uint n)
+{
+    qsort(v, n, sizeof(double), benchCmp);
+    double sum = 0.0;
+    for(uint i = 0; i < n; i++){sum += v[i];}
+    r->min = v[0];
+    r->median = n % 2 == 1 ? v[n/2] : (v[n/2-1] + v[n/2]) * 0.5;
+    uint p = (uint)ceil(n * 0.99) - 1;
+    if(p >= n){p = n-1;}
+    r->p99 = v[p];
+    r->mean = sum / n;
+}
+
+// one lap around the volume, swooping down through the middle of it
+// and back out, frame `i` of `n` is always the same view
+void benchCamera(render_camera* c, const uint i, const uint n, const uint w, const uint h)
+{
+    const float a = (float)i / (float)n;
+    const float yaw = a * 360.f;
+    const float elevation = sinf(a * PI * 2.f) * 35.f;
+    const float radius = 200.f - (sinf(a * PI) * 150.f);
+    cameraOrbit(c, yaw, elevation, radius, w, h);
+}
+
+static inline double benchMs(const Uint64 a, const Uint64 b)
+{
+    return (double)(b - a) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void benchJSONString(FILE* f, const char* name, const char* s)
+{
+    fprintf(f, "\"%s\": \"", name);
+    for(NULL; *s != 0x00; s++)
+    {
+        if(*s == '"' || *s == '\\'){fprintf(f, "\\%c", *s);}
+        else if((uchar)*s >= 0x20){fputc(*s, f);}
+    }
+    fprintf(f, "\"");
+}
+void benchJSONStats(FILE* f, const char* name, const bench_stats* s)
+{
+    fprintf(f, "\"%s\": {\"min\": %.4f, \"median\": %.4f, \"p99\": %.4f, \"mean\": %.4f}", name, s->min, s->median, s->p99, s->mean);
+}
+void benchJSONLatency(FILE* f, const char* name, const lat_stats* s)
+{
+    fprintf(f, "\"%s\": {\"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"events\": %u}", name, s->p50, s->p95, s->p99, s->max, s->n);
+}
+
+// stands in for the mouse, events arrive at any point of a frame like
+// real ones so the latency includes the wait for the next poll
+SDL_atomic_t bench_input_on;
+int benchInput(void* arg)
+{
+    SDL_Event e;
+    memset(&e, 0, sizeof(SDL_Event));
+    e.type = SDL_USEREVENT;
+    while(SDL_AtomicGet(&bench_input_on) == 1)
+    {
+        SDL_PushEvent(&e);
+        SDL_Delay(BENCH_INPUT_MS);
+    }
+    return 0;
+}
+
+// ./wox bench <project> <json_path> <frames> <WxH,WxH,...>
+// expects the window, shader and voxel texture to be ready as they are
+// right before the main loop starts
+int benchRun(const char* json_path, uint frames, const char* sizes)
+{
+    if(frames < 1){frames = BENCH_FRAMES;}
+    char tmp[16];
+
+    bench_run runs[BENCH_MAX_SIZES];
+    uint nruns = 0;
+    char sz[256];
+    snprintf(sz, 256, "%s", sizes);
+    for(char* tok = strtok(sz, ","); tok != NULL && nruns < BENCH_MAX_SIZES; tok = strtok(NULL, ","))
+    {
+        uint w = 0, h = 0;
+        if(sscanf(tok, "%ux%u", &w, &h) != 2 || w < 16 || h < 16 || w > 8192 || h > 8192)
+        {
+            printf("ERROR: bad bench resolution \"%s\".\n", tok);
+            return 1;
+        }
+        runs[nruns].w = w, runs[nruns].h = h;
+        nruns++;
+    }
+    if(nruns == 0){printf("ERROR: no bench resolutions.\n"); return 1;}
+
+    double* cpu = malloc(frames*sizeof(double));
+    double* gpu = malloc(frames*sizeof(double));
+    double* frm = malloc(frames*sizeof(double));
+    double* gpq = malloc(frames*sizeof(double));
+    float* lat = malloc(LAT_MAX*frames*LAT_PENDING*sizeof(float));
+    if(cpu == NULL || gpu == NULL || frm == NULL || gpq == NULL || lat == NULL){free(cpu); free(gpu); free(frm); free(gpq); free(lat); return 1;}
+    float* lat_sub = lat;
+    float* lat_swp = lat + frames*LAT_PENDING;
+
+    SDL_GL_SetSwapInterval(0); // never wait on vsync
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    timestamp(tmp);
+    printf("[%s] Benchmarking on %s (%s), %u frames per resolution.\n", tmp, renderer, version, frames);
+    const uint query = gpu_mode == GPU_QUERY;
+    SDL_AtomicSet(&bench_input_on, 1);
+    SDL_Thread* input = SDL_CreateThread(benchInput, "bench input", NULL);
+
+    for(uint r = 0; r < nruns; r++)
+    {
+        // the window manager has the last word on the size, so bench what we actually got
+        int dw, dh;
+        SDL_SetWindowSize(wnd, runs[r].w, runs[r].h);
+        SDL_GL_GetDrawableSize(wnd, &dw, &dh);
+        runs[r].w = dw, runs[r].h = dh;
+        WOX_POP(dw, dh);
+
+        // a blank hud means every pixel is raymarched
+        SDL_FillRect(sHud, &sHud->clip_rect, 0x00000000);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, voxelmap);
+        glUniform1i(voxel_id, 0);
+        glActiveTexture(GL_TEXTURE1);
+        flipHud();
+        glUniform1i(hud_id, 1);
+
+        runs[r].queries = 0;
+        uint lats = 0;
+        for(int i = -BENCH_WARMUP; i < (int)frames; i++)
+        {
+            SDL_Event event;
+            while(SDL_PollEvent(&event))
+                if(event.type == SDL_USEREVENT){latInput(event.common.timestamp);}
+
+            const Uint64 t0 = SDL_GetPerformanceCounter();
+            render_camera c;
+            benchCamera(&c, i < 0 ? 0 : i, frames, dw, dh);
+            cameraUniforms(&c);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if(query == 1){gpuBegin();}
+            glDrawElements(GL_TRIANGLES, hud_numind, GL_UNSIGNED_BYTE, 0);
+            if(query == 1){gpuEnd();}
+            latSubmit();
+            const Uint64 t1 = SDL_GetPerformanceCounter();
+            glFinish();
+            const Uint64 t2 = SDL_GetPerformanceCounter();
+            const uint got = query == 1 ? gpuPoll() : 0;
+            SDL_GL_SwapWindow(wnd);
+            const Uint64 t3 = SDL_GetPerformanceCounter();
+            const uint events = latSwap();
+            if(i < 0){continue;}
+            for(uint e = lat_head - events; e != lat_head; e++, lats++)
+            {
+                lat_sub[lats] = lat_ms[LAT_SUBMIT][e & (LAT_SAMPLES-1)];
+                lat_swp[lats] = lat_ms[LAT_SWAP][e & (LAT_SAMPLES-1)];
+            }
+            if(got > 0){gpq[runs[r].queries++] = gpu_ms;}
+            cpu[i] = benchMs(t0, t1);
+            gpu[i] = benchMs(t1, t2);
+            frm[i] = benchMs(t0, t3);
+        }
+        benchStats(&runs[r].cpu, cpu, frames);
+        benchStats(&runs[r].gpu, gpu, frames);
+        benchStats(&runs[r].frame, frm, frames);
+        if(runs[r].queries > 0){benchStats(&runs[r].query, gpq, runs[r].queries);}
+        latStats(&runs[r].latency[LAT_SUBMIT], lat_sub, lats);
+        latStats(&runs[r].latency[LAT_SWAP], lat_swp, lats);
+
+        timestamp(tmp);
+        printf("[%s] %ux%u: frame %.3f ms median, %.3f ms p99 | cpu %.3f ms | gpu %.3f ms median, %.3f ms p99 | %.1f fps\n",
+            tmp, runs[r].w, runs[r].h, runs[r].frame.median, runs[r].frame.p99, runs[r].cpu.median,
+            runs[r].gpu.median, runs[r].gpu.p99, 1000.0 / runs[r].frame.mean);
+        if(runs[r].queries > 0)
+            printf("[%s] %ux%u: raymarch %.3f ms median, %.3f ms p99 (%u timer queries)\n",
+                tmp, runs[r].w, runs[r].h, runs[r].query.median, runs[r].query.p99, runs[r].queries);
+        printf("[%s] %ux%u: input to swap %.3f ms median, %.3f ms p99, %.3f ms max (%u events)\n",
+            tmp, runs[r].w, runs[r].h, runs[r].latency[LAT_SWAP].p50, runs[r].latency[LAT_SWAP].p99, runs[r].latency[LAT_SWAP].max, runs[r].latency[LAT_SWAP].n);
+    }
+    SDL_AtomicSet(&bench_input_on, 0);
+    if(input != NULL){SDL_WaitThread(input, NULL);}
+    free(cpu);
+    free(gpu);
+    free(frm);
+    free(gpq);
+    free(lat);
+
+    if(json_path == NULL){return 0;}
+    FILE* f = exportOpen(json_path);
+    if(f == NULL)
+    {
+        timestamp(tmp);
+        printf("[%s] Failed to write: %s\n", tmp, json_path);
+        return 1;
+    }
+    fprintf(f, "{\n  ");
+    benchJSONString(f, "version", appVersion);
+    fprintf(f, ",\n  ");
+    benchJSONString(f, "project", openTitle);
+    fprintf(f, ",\n  ");
+    benchJSONString(f, "gl_renderer", renderer);
+    fprintf(f, ",\n  ");
+    benchJSONString(f, "gl_version", version);
+    fprintf(f, ",\n  ");
+    benchJSONString(f, "gpu_timer", query == 1 ? gpu_names[GPU_QUERY] : gpu_names[GPU_FINISH]);
+    fprintf(f, ",\n  \"frames\": %u,\n  \"warmup\": %u,\n  \"input_interval_ms\": %u,\n  \"runs\": [\n", frames, BENCH_WARMUP, BENCH_INPUT_MS);
+    for(uint r = 0; r < nruns; r++)
+    {
+        fprintf(f, "    {\"width\": %u, \"height\": %u, ", runs[r].w, runs[r].h);
+        benchJSONStats(f, "cpu_ms", &runs[r].cpu);
+        fprintf(f, ", ");
+        benchJSONStats(f, "gpu_ms", &runs[r].gpu);
+        fprintf(f, ", ");
+        if(runs[r].queries > 0)
+        {
+            benchJSONStats(f, "gpu_query_ms", &runs[r].query);
+            fprintf(f, ", \"gpu_queries\": %u, ", runs[r].queries);
+        }
+        benchJSONStats(f, "frame_ms", &runs[r].frame);
+        fprintf(f, ", ");
+        benchJSONLatency(f, "input_to_submit_ms", &runs[r].latency[LAT_SUBMIT]);
+        fprintf(f, ", ");
+        benchJSONLatency(f, "input_to_swap_ms", &runs[r].latency[LAT_SWAP]);
+        fprintf(f, "}%s\n", r+1 < nruns ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    uint ok = ferror(f) == 0;
+    ok &= fclose(f) == 0;
+    timestamp(tmp);
+    if(ok == 0){printf("[%s] Failed to write: %s\n", tmp, json_path); return 1;}
+    printf("[%s] Saved benchmark: %s\n", tmp, json_path);
+    return 0;
+}
+
+//*************************************
+// micro benchmarks
+//*************************************
+#define MICRO_REPS 15
+#define MICRO_WARMUP 2
+#define MICRO_BUDGET 2.0    // seconds, stop repeating a slow path early
+#define MICRO_RAYS 256
+#define MICRO_VOLUMES 5
+#define MICRO_MAX_RESULTS 128
+const char* micro_volumes[MICRO_VOLUMES] = {"empty", "noise", "solid", "shell", "terrain"};
+
+typedef struct
+{
+    const char* volume;
+    char path[32];
+    double ns;      // median nanoseconds per op
+    double mbs;     // megabytes per second, 0 if it does not apply
+    uint reps;
+}
+micro_result;
+
+typedef struct
+{
+    vec start[MICRO_RAYS];  // ray origins in voxel space
+    vec dir[MICRO_RAYS];    // unit look directions
+    voxel_masks* masks;
+    char file[1024];        // scratch file for save, load and exports
+    uint type;
+    uchar* px;
+    micro_result res[MICRO_MAX_RESULTS];
+    uint nres;
+}
+micro_job;
+
+// synthetic volumes, always the same voxels for the same type
+void microVolume(game_state* s, const uint type)
+{
+    for(uint i = 0; i < 39; i++)
+        s->colors[i] = ((((i*53)&0xFF)|1) << 16) | ((((i*97)&0xFF)|1) << 8) | (((i*193)&0xFF)|1);
+    memset(s->voxels, 0, max_voxels);
+    srandf(1337);
+    for(uint z = 0; z < 128; z++)
+    for(uint y = 0; y < 128; y++)
+    for(uint x = 0; x < 128; x++)
+    {
+        const uchar c = 8 + (((x/8) + (y/8) + (z/8)) % 32);
+        const float dx = x-63.5f, dy = y-63.5f, dz = z-63.5f;
+        const float d = sqrtf(dx*dx + dy*dy + dz*dz);
+        uchar v = 0;
+        if(type == 1 && randf() < 0.05f){v = 8 + (uint)(randf()*31.99f);}  // sparse noise
+        else if(type == 2){v = c;}                                          // solid
+        else if(type == 3 && d > 58.f && d < 60.f){v = c;}                  // hollow shell
+        else if(type == 4)                                                  // terrain
+        {
+            const float hgt = 40.f + 12.f*sinf(x*0.1f)*cosf(y*0.13f) + 6.f*sinf((x+y)*0.05f);
+            if(z < hgt){v = 8 + (z/4)%32;}
+        }
+        s->voxels[PTI(x, y, z)] = v;
+    }
+}
+
+volatile int micro_sink; // results go here so the compiler cannot drop the work
+
+void micro_ray(micro_job* j)
+{
+    vec hp, hv;
+    for(uint i = 0; i < MICRO_RAYS; i++)
+    {
+        look_dir = j->dir[i];
+        micro_sink = ray(&hp, &hv, j->start[i]);
+    }
+}
+void micro_traceViewPath(micro_job* j)
+{
+    for(uint i = 0; i < MICRO_RAYS; i++)
+    {
+        look_dir = j->dir[i];
+        ipp = j->start[i];
+        traceViewPath(1);
+    }
+}
+void micro_placedVoxels(micro_job* j){micro_sink = placedVoxels();}
+void micro_texture(micro_job* j){updateVoxelSurface();}
+void micro_save(micro_job* j){writeState(&g, j->file);}
+void micro_load(micro_job* j){readState(&g, j->file);}
+void micro_masks(micro_job* j){voxelMasks(j->masks, &g);}
+void micro_export(micro_job* j){exportState(&g, j->masks, j->type, j->file);}
+void micro_preview(micro_job* j)
+{
+    render_camera c;
+    cameraOrbit(&c, 45.f, 30.f, 200.f, 256, 256);
+    renderImage(j->px, &g, &c, 256, 256, 0);
+}
+
+// median time of `fn` over the repetitions after a short warm up
+void microRun(micro_job* j, const char* volume, const char* path, void (*fn)(micro_job*), const uint ops, const double bytes, const uint reps)
+{
+    double t[64];
+    for(uint i = 0; i < MICRO_WARMUP; i++){fn(j);}
+    const Uint64 st = SDL_GetPerformanceCounter();
+    uint n = 0;
+    while(n < reps && n < 64)
+    {
+        const Uint64 t0 = SDL_GetPerformanceCounter();
+        fn(j);
+        const Uint64 t1 = SDL_GetPerformanceCounter();
+        t[n++] = benchMs(t0, t1) * 1e6;
+        if(n >= 3 && benchMs(st, t1) > MICRO_BUDGET*1000.0){break;}
+    }
+    qsort(t, n, sizeof(double), benchCmp);
+    const double med = n % 2 == 1 ? t[n/2] : (t[n/2-1] + t[n/2]) * 0.5;
+
+    micro_result* r = &j->res[j->nres < MICRO_MAX_RESULTS-1 ? j->nres++ : j->nres];
+    r->volume = volume;
+    snprintf(r->path, 32, "%s", path);
+    r->ns = med / ops;
+    r->mbs = bytes > 0.0 ? bytes * 1000.0 / med : 0.0;
+    r->reps = n;
+    if(r->mbs > 0.0){printf("%-8s %-16s %14.1f ns/op %10.1f MB/s\n", volume, path, r->ns, r->mbs);}
+    else{printf("%-8s %-16s %14.1f ns/op\n", volume, path, r->ns);}
+    fflush(stdout);
+}
+
+double microFileSize(const char* file)
+{
+    FILE* f = fopen(file, "rb");
+    if(f == NULL){return 0.0;}
+    fseek(f, 0, SEEK_END);
+    const long l = ftell(f);
+    fclose(f);
+    return (double)l;
+}
+
+// ./wox microbench <reps> <json_path>
+int microBench(int argc, char** argv)
+{
+    uint reps = argc >= 3 ? atoi(argv[2]) : MICRO_REPS;
+    if(reps < 1){reps = MICRO_REPS;}
+    if(reps > 64){reps = 64;}
+    const char* json_path = argc >= 4 ? argv[3] : NULL;
+
+    micro_job* j = malloc(sizeof(micro_job));
+    voxel_masks* m = malloc(sizeof(voxel_masks));
+    uchar* px = malloc(256*256*3);
+    if(j == NULL || m == NULL || px == NULL){free(j); free(m); free(px); return 1;}
+    memset(j, 0, sizeof(micro_job));
+    j->masks = m;
+    j->px = px;
+    snprintf(j->file, 1024, "%smicrobench.tmp", appdir);
+    if(sVoxel == NULL){sVoxel = SDL_RGBA32Surface(1024, 2048);}
+
+    // rays from just outside the volume towards its middle, like an artist orbiting a model
+    srandf(42);
+    for(uint i = 0; i < MICRO_RAYS; i++)
+    {
+        vec d = (vec){randfc(), randfc(), randfc()};
+        vNorm(&d);
+        j->start[i] = (vec){63.5f + d.x*80.f, 63.5f + d.y*80.f, 63.5f + d.z*80.f};
+        vec l = (vec){-d.x + randfc()*0.3f, -d.y + randfc()*0.3f, -d.z + randfc()*0.3f};
+        vNorm(&l);
+        j->dir[i] = l;
+    }
+
+    char tmp[16];
+    timestamp(tmp);
+    printf("[%s] Micro benchmarks, median of up to %u runs.\n", tmp, reps);
+    for(uint v = 0; v < MICRO_VOLUMES; v++)
+    {
+        const char* vol = micro_volumes[v];
+        microVolume(&g, v);
+        defaultState(0);
+        microRun(j, vol, "ray", micro_ray, MICRO_RAYS, 0.0, reps);
+        microRun(j, vol, "traceViewPath", micro_traceViewPath, MICRO_RAYS, 0.0, reps);
+        microRun(j, vol, "placedVoxels", micro_placedVoxels, 1, max_voxels, reps);
+        microRun(j, vol, "texture_rebuild", micro_texture, 1, max_voxels*4.0, reps);
+        microRun(j, vol, "saveState", micro_save, 1, sizeof(game_state), reps);
+        microRun(j, vol, "loadState", micro_load, 1, sizeof(game_state), reps);
+        microRun(j, vol, "voxelMasks", micro_masks, 1, max_voxels, reps);
+        voxelMasks(m, &g);
+        for(uint e = 0; e < EXPORT_MAX; e++)
+        {
+            char name[32];
+            snprintf(name, 32, "export_%s", export_names[e]);
+            j->type = e;
+            micro_export(j);
+            microRun(j, vol, name, micro_export, 1, microFileSize(j->file), reps);
+        }
+        microRun(j, vol, "preview_256", micro_preview, 1, 0.0, reps);
+    }
+    remove(j->file);
+
+    int r = 0;
+    if(json_path != NULL)
+    {
+        FILE* f = exportOpen(json_path);
+        if(f != NULL)
+        {
+            fprintf(f, "{\n  ");
+            benchJSONString(f, "version", appVersion);
+            fprintf(f, ",\n  \"rays\": %u,\n  \"results\": [\n", MICRO_RAYS);
+            for(uint i = 0; i < j->nres; i++)
+            {
+                const micro_result* e = &j->res[i];
+                fprintf(f, "    {\"volume\": \"%s\", \"path\": \"%s\", \"ns_per_op\": %.2f, \"mb_per_s\": %.2f, \"reps\": %u}%s\n",
+                    e->volume, e->path, e->ns, e->mbs, e->reps, i+1 < j->nres ? "," : "");
+            }
+            fprintf(f, "  ]\n}\n");
+            uint ok = ferror(f) == 0;
+            ok &= fclose(f) == 0;
+            if(ok == 0){r = 1;}
+        }
+        else{r = 1;}
+        timestamp(tmp);
+        if(r == 1){printf("[%s] Failed to write: %s\n", tmp, json_path);}
+        else{printf("[%s] Saved benchmark: %s\n", tmp, json_path);}
+    }
+    free(px);
+    free(m);
+    free(j);
+    return r;
+}
+
+#endif
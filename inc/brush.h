@@ -0,0 +1,126 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Brush functions.
+
+    A brush is a cube, sphere or upright cylinder of radius 1 to 32, a
+    radius of 1 being the single voxel the editor always placed. When the
+    shape or size changes it is rasterized once into the half width of
+    its x row at every (y,z) offset, so a stroke is one clipped span per
+    row over the PTI() layout and one dirty box for the texture upload.
+*/
+
+#ifndef BRUSH_H
+#define BRUSH_H
+
+#define BRUSH_MAX 32
+#define BRUSH_ROWS (BRUSH_MAX*2-1)
+
+enum{BRUSH_CUBE, BRUSH_SPHERE, BRUSH_CYLINDER, BRUSH_SHAPES};
+const char* brush_names[BRUSH_SHAPES] = {"Cube", "Sphere", "Cylinder"};
+enum{BRUSH_PLACE, BRUSH_DELETE, BRUSH_PAINT};
+
+uint brush_shape = BRUSH_CUBE;
+uint brush_size = 1;
+signed char brush_span[BRUSH_ROWS][BRUSH_ROWS]; // [z][y] half width of the row, -1 is empty, zeroed is radius 1
+
+// rasterize the current shape and size into brush_span
+void brushBuild()
+{
+    const int r = brush_size-1;
+    const float rr = ((float)brush_size-0.5f) * ((float)brush_size-0.5f);
+    memset(brush_span, -1, sizeof(brush_span));
+    for(int z = -r; z <= r; z++)
+    {
+        for(int y = -r; y <= r; y++)
+        {
+            float d = rr;
+            if(brush_shape == BRUSH_SPHERE){d -= (float)(y*y + z*z);}
+            else if(brush_shape == BRUSH_CYLINDER){d -= (float)(y*y);}
+            if(brush_shape == BRUSH_CUBE){brush_span[z+r][y+r] = r;}
+            else if(d >= 0.f){brush_span[z+r][y+r] = (signed char)sqrtf(d);}
+        }
+    }
+}
+
+// the brush centred on (cx,cy,cz), parts outside the volume are dropped,
+// returns the voxels changed
+uint brushApply(game_state* s, const int cx, const int cy, const int cz, const uint op, const uchar color)
+{
+    const int r = brush_size-1;
+    uint n = 0;
+    for(int dz = -r; dz <= r; dz++)
+    {
+        const int z = cz+dz;
+        if(z < 0 || z > 127){continue;}
+        for(int dy = -r; dy <= r; dy++)
+        {
+            const int y = cy+dy;
+            const int hx = brush_span[dz+r][dy+r];
+            if(hx < 0 || y < 0 || y > 127){continue;}
+            const int x0 = cx-hx < 0 ? 0 : cx-hx;
+            const int x1 = cx+hx > 127 ? 127 : cx+hx;
+            if(x0 > x1){continue;}
+            const uint i0 = PTI(x0, y, z);
+            const uint w = x1-x0+1;
+            if(op == BRUSH_DELETE){n += editSpan(s, i0, w, 0);}
+            else if(op == BRUSH_PLACE){n += editPlace(s, i0, w, color);}
+            else{n += editPaint(s, i0, w, color);}
+        }
+    }
+    return n;
+}
+
+//*************************************
+// editor
+//*************************************
+
+// where the brush goes for the last traceViewPath(), 0 when nowhere. A
+// placed brush sits on the picked face rather than sinking into it.
+uint brushCentre(const uint op, int c[3])
+{
+    if(lray < 0){return 0;}
+    c[0] = ghp.x, c[1] = ghp.y, c[2] = ghp.z;
+    if(op == BRUSH_PLACE)
+    {
+        if(g.pb.w != 1.f || (brush_size == 1 && isInBounds(g.pb) == 0)){return 0;}
+        const int r = brush_size-1;
+        c[0] = (int)g.pb.x + ((int)g.pb.x-c[0])*r;
+        c[1] = (int)g.pb.y + ((int)g.pb.y-c[1])*r;
+        c[2] = (int)g.pb.z + ((int)g.pb.z-c[2])*r;
+    }
+    return 1;
+}
+
+// place, delete or paint with the brush at `c` and its symmetry images
+void brushStamp(const uint op, const int c[3])
+{
+    int p[SYM_MAX][3];
+    const uint np = symPoints(c[0], c[1], c[2], p);
+    uint n = 0;
+    for(uint i = 0; i < np; i++){n += brushApply(&g, p[i][0], p[i][1], p[i][2], op, g.st);}
+    prof_count.edits += n;
+}
+
+// at the last traceViewPath(), at radius 1 this is the editor's single voxel edit
+void brushEdit(const uint op)
+{
+    int c[3];
+    if(brushCentre(op, c) == 1){brushStamp(op, c);}
+}
+
+// bracket keys size the brush, L changes its shape
+void brushSet(const uint shape, const uint size)
+{
+    brush_shape = shape % BRUSH_SHAPES;
+    brush_size = size < 1 ? 1 : size > BRUSH_MAX ? BRUSH_MAX : size;
+    brushBuild();
+    if(brush_size == 1){sprintf(warnm, "Single voxel brush.");}
+    else{sprintf(warnm, "%s brush radius %u.", brush_names[brush_shape], brush_size);}
+    wti = t+1.f;
+}
+
+#endif
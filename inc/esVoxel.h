@@ -54,7 +54,7 @@ GLuint hudmap;
 // SHADER
 //*************************************
 void makeHud();
-void shadeHud(GLint* position, GLint* hud, GLint* look_pos, GLint* scale, GLint* view, GLint* voxels);
+void shadeHud(GLint* position, GLint* hud, GLint* look_pos, GLint* scale, GLint* pixel, GLint* view, GLint* voxels);
 void flipHud()
 {
     glBindTexture(GL_TEXTURE_2D, hudmap);
@@ -132,21 +132,8 @@ const GLchar* v0 =
 	"#version 100\n"
 	"attribute vec2 position;\n"
 
-	"uniform vec2 scale;\n"
-	"uniform vec3 view[3];\n"
-
-	"varying vec3 ray_dir;\n"
-	"varying vec2 screen_pos;\n"
-
 	"void main()\n"
 	"{\n"
-		"vec3 forward = view[2];\n"
-		"vec3 up      = view[1];\n"
-		"vec3 right   = view[0];\n"
-
-		"ray_dir = forward + (up*(position.y * scale.y)) + (right*(position.x * scale.x));\n"
-
-		"screen_pos = vec2((position.x * 0.5) + 0.5, ((-position.y) * 0.5) + 0.5);\n"
 		"gl_Position = vec4(position, 1.0, 1.0);\n"
 	"}\n";
 
@@ -154,8 +141,15 @@ const GLchar* f0 =
 	"#version 100\n"
 	"precision highp float;\n"
 
-	"varying vec3 ray_dir;\n"
-	"varying vec2 screen_pos;\n"
+	// the ray is made per pixel from gl_FragCoord rather than interpolated
+	// from the corners, so renderWorker() in render.h can do the same sums
+	// and pick the same voxel on every ray
+	"uniform vec2 scale;\n"
+	"uniform vec2 pixel;\n" // 1/width, 1/height
+	"uniform vec3 view[3];\n"
+
+	"vec3 ray_dir;\n"
+	"vec2 screen_pos;\n"
 
 	"uniform sampler2D voxels;\n" // no dynamic array indexing? fine, dynamic not-array indexing it is
 	"uniform sampler2D hud;\n"
@@ -385,6 +379,12 @@ const GLchar* f0 =
 
 	"void main()\n"
 	"{\n"
+		"screen_pos.x = gl_FragCoord.x * pixel.x;\n"
+		"screen_pos.y = 1.0 - (gl_FragCoord.y * pixel.y);\n"
+		"float px = ((screen_pos.x * 2.0) - 1.0) * scale.x;\n"
+		"float py = (1.0 - (screen_pos.y * 2.0)) * scale.y;\n"
+		"ray_dir = (view[2] + (view[1] * py)) + (view[0] * px);\n"
+
 		"vec4 color = texture2D(hud, screen_pos);\n"
 		"if (color.a != 1.0) {\n"
 			"ray();\n"
@@ -401,6 +401,7 @@ GLint  shdHud_position;
 GLint  shdHud_hud;
 GLint  shdHud_look_pos;
 GLint  shdHud_scale;
+GLint  shdHud_pixel;
 GLint  shdHud_view;
 GLint  shdHud_voxels;
 
@@ -461,18 +462,20 @@ void makeHud()
     shdHud_voxels    = glGetUniformLocation(shdHud, "voxels");
     shdHud_look_pos   = glGetUniformLocation(shdHud, "look_pos");
     shdHud_scale      = glGetUniformLocation(shdHud, "scale");
+    shdHud_pixel      = glGetUniformLocation(shdHud, "pixel");
     shdHud_view       = glGetUniformLocation(shdHud, "view");
     shdHud_hud       = glGetUniformLocation(shdHud, "hud");
 
     esBind(GL_ARRAY_BUFFER, &mdlPlane.vid, &hud_vertices, sizeof(hud_vertices), GL_STATIC_DRAW);
     esBind(GL_ELEMENT_ARRAY_BUFFER, &mdlPlane.iid, &hud_indices, sizeof(hud_indices), GL_STATIC_DRAW);
 }
-void shadeHud(GLint* position, GLint* hud, GLint* look_pos, GLint* scale, GLint* view, GLint* voxels)
+void shadeHud(GLint* position, GLint* hud, GLint* look_pos, GLint* scale, GLint* pixel, GLint* view, GLint* voxels)
 {
     *position = shdHud_position;
     *hud = shdHud_hud;
     *look_pos = shdHud_look_pos;
     *scale = shdHud_scale;
+    *pixel = shdHud_pixel;
     *view = shdHud_view;
     *voxels = shdHud_voxels;
     glUseProgram(shdHud);
@@ -27,6 +27,8 @@
 #define sint GLint
 #define uchar unsigned char
 
+#include "profile.h"
+
 // render state id's
 GLint projection_id;
 GLint view_id;
@@ -36,6 +38,7 @@ GLint texcoord_id;
 GLint hud_id;
 GLint look_pos_id;
 GLint scale_id;
+GLint pixel_id;
 
 // render state matrices
 mat projection;
@@ -58,6 +61,7 @@ float ww, wh;
 float aspect, t = 0.f;
 uint wayland=0,maxed=0,size=0,dsx=0,dsy=0;
 uint g_fps = 0;
+float g_gpums = 0.f;    // average gpu ms per draw over the fps window
 uint ks[10] = {0};      // keystate
 uint focus_mouse = 0;   // mouse lock
 uint showhud = 1;       // hud visibility
@@ -65,17 +69,31 @@ float vdist = 4096.f;   // view distance
 vec ipp;                // inverse player position
 vec look_dir;           // camera look direction
 int lray = 0;           // pointed at node index
-float ptt = 0.f;        // place timing trigger (for repeat place)
-float dtt = 0.f;        // delete timing trigger (for repeat delete)
-float rtt = 0.f;        // replace timing trigger (for repeat replace)
-float rrsp = 0.3f;      // repeat replace speed
+float rrsp = 0.3f;      // repeat delay for held edits and paste
 uint fks = 0;           // F-Key state (fast mode toggle)
 float bigc = 0.f;       // big cursor start time
 Uint32 sclr = 0;        // selected color
 uint load_state = 0;    // loaded from appdir or custom path?
-uint mirror = 0;        // mirror brush state
 vec ghp;                // global ray hit position
 uint has_changed = 1;   // do the render buffers need re-building?
+typedef struct
+{
+    uchar x0, y0, z0; // inclusive, x0 <= x1 etc
+    uchar x1, y1, z1;
+}
+region_box;
+#define EDIT_NONE 2097152               // lo of an empty span, one past the last voxel
+#define EDIT_BOXES 8                    // edits apart, like symmetry copies, keep a box each
+uint edit_lo = EDIT_NONE, edit_hi = 0;   // voxels edited this frame, see markDirty()
+region_box edit_boxes[EDIT_BOXES];       // and the boxes around them
+uint edit_nboxes = 0;
+region_box dirty_boxes[EDIT_BOXES];      // or just these boxes, see editFlush()
+uint dirty_nboxes = 0;
+uint undo_lo = EDIT_NONE, undo_hi = 0;   // voxels edited since the last undo record
+region_box edit_aabb;                    // bounds of the last frame's change set, if edit_changed
+uint edit_changed = 0;
+region_box journal_aabb;                 // bounds of every edit since the last save or load, if edit_unsaved
+uint edit_unsaved = 0;
 float wti = 0.f;        // warning message timer for system colors tooltip
 char warnm[256];        // warning message string
 
@@ -175,7 +193,8 @@ int ray(vec* hit_pos, vec* hit_vec, const vec start_pos) // the look vector is a
     vMulS(&inc, look_dir, 0.015625f); // 0.0625f
     int hit = -1;
     vec rp = start_pos;
-    for(uint i = 0; i < 8192; i++) // 2048
+    uint i = 0;
+    for(NULL; i < 8192; i++) // 2048
     {
         vAdd(&rp, rp, inc);
         if(isInBounds(rp) == 0){continue;} // break;
@@ -194,10 +213,13 @@ int ray(vec* hit_pos, vec* hit_vec, const vec start_pos) // the look vector is a
         }
         if(hit > -1){break;}
     }
+    prof_count.rays++;
+    prof_count.steps += hit > -1 ? i+1 : i;
     return hit;
 }
 void traceViewPath(const uint face)
 {
+    PROF_BEGIN(PROF_TRACE);
     g.pb.w = -1.f; // pre-set as failed
     vec rp;
     lray = ray(&ghp, &rp, ipp);
@@ -228,6 +250,7 @@ void traceViewPath(const uint face)
             g.pb.w = 1.f; // success
        }
     }
+    PROF_END(PROF_TRACE);
 }
 
 // int ray(vec* hit_pos, vec pos) // look vector is still a global, not going to mess with that for now
@@ -468,7 +491,17 @@ void traceViewPath(const uint face)
 //*************************************
 // utility functions
 //*************************************
-void timestamp(char* ts){const time_t tt = time(0);strftime(ts, 16, "%H:%M:%S", localtime(&tt));}
+void timestamp(char* ts) // batch and lod workers call this too, so the reentrant localtime
+{
+    const time_t tt = time(0);
+    struct tm lt;
+#ifdef _WIN32
+    localtime_s(&lt, &tt);
+#else
+    localtime_r(&tt, &lt);
+#endif
+    strftime(ts, 16, "%H:%M:%S", &lt);
+}
 float fTime(){return ((float)SDL_GetTicks())*0.001f;}
 #ifdef __linux__
     uint64_t microtime()
@@ -553,9 +586,149 @@ uint isWayland()
     return 1;
 }
 
+// minimal png encoder, rgb (3) or rgba (4) channels, returns a malloc'd buffer
+void pngChunk(uchar* o, size_t* len, const char* type, const uchar* d, const uint n)
+{
+    uchar* p = o + *len;
+    p[0] = n >> 24, p[1] = n >> 16, p[2] = n >> 8, p[3] = n;
+    memcpy(p+4, type, 4);
+    if(n > 0){memcpy(p+8, d, n);}
+    const uint c = crc32(0, p+4, n+4);
+    p[n+8] = c >> 24, p[n+9] = c >> 16, p[n+10] = c >> 8, p[n+11] = c;
+    *len += n+12;
+}
+uchar* pngEncode(const uchar* px, const uint w, const uint h, const uint channels, size_t* len)
+{
+    const size_t row = w*channels;
+    const size_t raw_len = (row+1)*h;
+    uchar* raw = malloc(raw_len);
+    for(uint y = 0; y < h; y++)
+    {
+        raw[y*(row+1)] = 0; // no filter
+        memcpy(raw + y*(row+1) + 1, px + y*row, row);
+    }
+    uLongf zlen = compressBound(raw_len);
+    uchar* o = malloc(zlen + 57);
+    uchar* z = malloc(zlen);
+    compress2(z, &zlen, raw, raw_len, 6);
+    free(raw);
+    memcpy(o, "\x89PNG\r\n\x1a\n", 8);
+    *len = 8;
+    const uchar ihdr[13] = {w >> 24, w >> 16, w >> 8, w, h >> 24, h >> 16, h >> 8, h, 8, channels == 4 ? 6 : 2, 0, 0, 0};
+    pngChunk(o, len, "IHDR", ihdr, 13);
+    pngChunk(o, len, "IDAT", z, zlen);
+    pngChunk(o, len, "IEND", NULL, 0);
+    free(z);
+    return o;
+}
+
+// minimal png decoder for 8 bit rgb and rgba without interlacing, any
+// row filter, returns a malloc'd w*h*3 rgb buffer or NULL
+static inline uchar pngPaeth(const int a, const int b, const int c)
+{
+    const int p = a+b-c, pa = abs(p-a), pb = abs(p-b), pc = abs(p-c);
+    if(pa <= pb && pa <= pc){return a;}
+    return pb <= pc ? b : c;
+}
+uchar* pngDecode(const uchar* d, const size_t len, uint* w, uint* h)
+{
+    if(len < 33 || memcmp(d, "\x89PNG\r\n\x1a\n", 8) != 0 || memcmp(d+12, "IHDR", 4) != 0){return NULL;}
+    *w = (d[16] << 24) | (d[17] << 16) | (d[18] << 8) | d[19];
+    *h = (d[20] << 24) | (d[21] << 16) | (d[22] << 8) | d[23];
+    const uint ch = d[25] == 6 ? 4 : d[25] == 2 ? 3 : 0;
+    if(d[24] != 8 || ch == 0 || d[28] != 0 || *w == 0 || *h == 0 || *w > 16384 || *h > 16384){return NULL;}
+
+    // gather the IDAT chunks
+    uchar* z = malloc(len);
+    if(z == NULL){return NULL;}
+    size_t zlen = 0;
+    for(size_t p = 8; p+12 <= len;)
+    {
+        const size_t n = ((size_t)d[p] << 24) | (d[p+1] << 16) | (d[p+2] << 8) | d[p+3];
+        if(p+12+n > len){break;}
+        if(memcmp(d+p+4, "IDAT", 4) == 0){memcpy(z+zlen, d+p+8, n); zlen += n;}
+        if(memcmp(d+p+4, "IEND", 4) == 0){break;}
+        p += n+12;
+    }
+
+    const size_t row = (size_t)*w*ch;
+    uLongf raw_len = (row+1)*(*h);
+    uchar* raw = malloc(raw_len);
+    uchar* px = malloc((size_t)*w*(*h)*3);
+    if(raw == NULL || px == NULL || uncompress(raw, &raw_len, z, zlen) != Z_OK || raw_len != (row+1)*(*h))
+    {
+        free(z);
+        free(raw);
+        free(px);
+        return NULL;
+    }
+    free(z);
+
+    // undo the row filters in place, then drop alpha
+    for(uint y = 0; y < *h; y++)
+    {
+        const uchar f = raw[y*(row+1)];
+        uchar* r = raw + y*(row+1) + 1;
+        const uchar* u = y > 0 ? r-(row+1) : NULL;
+        for(size_t x = 0; x < row; x++)
+        {
+            const int a = x >= ch ? r[x-ch] : 0;
+            const int b = u != NULL ? u[x] : 0;
+            const int c = x >= ch && u != NULL ? u[x-ch] : 0;
+            if(     f == 1){r[x] += a;}
+            else if(f == 2){r[x] += b;}
+            else if(f == 3){r[x] += (a+b) >> 1;}
+            else if(f == 4){r[x] += pngPaeth(a, b, c);}
+        }
+        for(uint x = 0; x < *w; x++)
+        {
+            uchar* o = px + ((size_t)y*(*w) + x)*3;
+            o[0] = r[x*ch], o[1] = r[x*ch+1], o[2] = r[x*ch+2];
+        }
+    }
+    free(raw);
+    return px;
+}
+
 //*************************************
 // save and load functions
 //*************************************
+uint writeState(const game_state* s, const char* file)
+{
+    gzFile f = gzopen(file, "wb9hR");
+    if(f == Z_NULL){return 0;}
+    PROF_BEGIN(PROF_SAVE);
+    const size_t ws = sizeof(game_state);
+    if(gzwrite(f, s, ws) != ws)
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] Save corrupted.\n", tmp);
+    }
+    gzclose(f);
+    PROF_END(PROF_SAVE);
+    return 1;
+}
+uint readState(game_state* s, const char* file)
+{
+    gzFile f = gzopen(file, "rb");
+    if(f == Z_NULL){return 0;}
+    PROF_BEGIN(PROF_LOAD);
+    // a short read is a truncated or damaged file, `s` is left as it was
+    game_state* t = malloc(sizeof(game_state));
+    const uint r = t != NULL && gzread(f, t, sizeof(game_state)) == sizeof(game_state);
+    gzclose(f);
+    if(r == 1){memcpy(s, t, sizeof(game_state));}
+    else
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] Load failed, %s is truncated or damaged.\n", tmp, file);
+    }
+    free(t);
+    PROF_END(PROF_LOAD);
+    return r;
+}
 void saveState(const char* name, const char* fne, const uint fs)
 {
 #ifdef __linux__
@@ -566,19 +739,17 @@ void saveState(const char* name, const char* fne, const uint fs)
     sprintf(file, "%s%s.wox.gz%s", appdir, name, fne);
     if(fs == 0){sprintf(file, "%s%s.wox.gz%s", appdir, name, fne);}
     else{sprintf(file, "%s", name);}
-    gzFile f = gzopen(file, "wb9hR");
-    if(f != Z_NULL)
+    if(writeState(&g, file) == 1)
     {
-        const size_t ws = sizeof(game_state);
-        if(gzwrite(f, &g, ws) != ws)
-        {
-            char tmp[16];
-            timestamp(tmp);
-            printf("[%s] Save corrupted.\n", tmp);
-        }
-        gzclose(f);
         char tmp[16];
         timestamp(tmp);
+        if(fne[0] != 0x00 && edit_unsaved == 1) // a backup, the project itself is still unsaved
+        {
+            const region_box* b = &journal_aabb;
+            printf("[%s] Backed up to %s, unsaved edits inside %u-%u, %u-%u, %u-%u.\n", tmp, file, b->x0, b->x1, b->y0, b->y1, b->z0, b->z1);
+            return;
+        }
+        if(fne[0] == 0x00){edit_unsaved = 0;}
 #ifndef __linux__
         printf("[%s] Saved %'u voxels.\n", tmp, placedVoxels());
 #else
@@ -595,12 +766,12 @@ uint loadState(const char* name, const uint fs)
     char file[1024];
     if(fs == 0){sprintf(file, "%s%s.wox.gz", appdir, name);}
     else{sprintf(file, "%s", name);}
-    gzFile f = gzopen(file, "rb");
-    if(f != Z_NULL)
+    if(readState(&g, file) == 1)
     {
-        int gr = gzread(f, &g, sizeof(game_state));
-        gzclose(f);
         fks = (g.ms == g.cms); // update F-Key State
+        edit_lo = EDIT_NONE, edit_hi = 0, edit_nboxes = 0; // the whole grid is new
+        has_changed = 1;
+        edit_unsaved = 0;
         char tmp[16];
         timestamp(tmp);
 #ifndef __linux__
@@ -610,77 +781,33 @@ uint loadState(const char* name, const uint fs)
 #endif
         return 1;
     }
+    // a damaged project is moved out of the way of the save on exit
+    FILE* f = fopen(file, "rb");
+    if(f != NULL)
+    {
+        fclose(f);
+        char bak[1040], tmp[16];
+        snprintf(bak, 1040, "%s.damaged", file);
+        timestamp(tmp);
+        if(rename(file, bak) == 0){printf("[%s] Moved it to %s.\n", tmp, bak);}
+    }
     return 0;
 }
-
-// voxel face rendering for ply
-void fw_mx(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
-}
-void fw_px(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
-}
-//
-void fw_my(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
-}
-void fw_py(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
-}
-//
-void fw_mz(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y+s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y-s, z-s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y-s, z-s, r, g, b);
-}
-void fw_pz(FILE* f, float x, float y, float z, uchar r, uchar g, uchar b)
-{
-    x -= 64.f, y -= 64.f;
-    const float s = 0.5f;
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y+s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y-s, z+s, r, g, b);
-    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+// the file a command line project argument refers to, plain project
+// names live in the appdir and anything with a slash or .wox.gz is a path
+void projectFile(char* file, const size_t size, const char* in)
+{
+    const size_t len = strlen(in);
+    if(strchr(in, '/') != NULL || (len > 7 && strcmp(in+len-7, ".wox.gz") == 0)){snprintf(file, size, "%s", in);}
+    else{snprintf(file, size, "%s%s.wox.gz", appdir, in);}
+}
+// a project argument minus any directory and .wox.gz, for naming outputs
+void projectName(char* name, const size_t size, const char* in)
+{
+    const char* base = strrchr(in, '/');
+    snprintf(name, size, "%s", base == NULL ? in : base+1);
+    const size_t len = strlen(name);
+    if(len > 7 && strcmp(name+len-7, ".wox.gz") == 0){name[len-7] = 0x00;}
 }
 
 //*************************************
@@ -743,6 +870,221 @@ void updateSelectColor()
                                     (tu & 0x0000FF00) >> 8,
                                      tu & 0x000000FF);
 }
+// voxel texture texel for color id `v`
+static inline Uint32 voxelTexel(const uchar v)
+{
+    if(v < 1){return 0x00000000;}
+    const uint32_t color = g.colors[v-1];
+    return (color >> 16) | (((color >> 8) & 0xFF) << 8) | ((color & 0xFF) << 16) | (0xFF << 24);
+}
+// rebuild the voxel texture from `g`, voxel_at() in f0 reads it back
+void updateVoxelSurface()
+{
+    for (int x = 0; x < 1024; x++)
+    for (int y = 0; y < 2048; y++) {
+        int index = (x * 2048) + y;
+        setpixel(sVoxel, x, y, voxelTexel(g.voxels[index]));
+    }
+}
+//*************************************
+// edits
+//*************************************
+// Every change to the voxels goes through the edit functions below, only
+// undo writes the grid itself and marks what it wrote with markDirty(). A
+// frame's changes gather into a span for undo and a few boxes for the
+// texture, editFlush() hands them on once a frame along with their
+// bounds, to the undo record, the texture upload and the save journal.
+
+// the box around voxels lo to hi along the PTI() order
+static inline region_box spanBox(const uint lo, const uint hi)
+{
+    const uchar lx = lo & 127, ly = (lo >> 7) & 127, lz = lo >> 14;
+    const uchar hx = hi & 127, hy = (hi >> 7) & 127, hz = hi >> 14;
+    if(lz != hz){return (region_box){0, 0, lz, 127, 127, hz};}
+    if(ly != hy){return (region_box){0, ly, lz, 127, hy, hz};}
+    return (region_box){lx, ly, lz, hx, hy, hz};
+}
+uint regionVolume(const region_box* b)
+{
+    return (b->x1-b->x0+1) * (b->y1-b->y0+1) * (b->z1-b->z0+1);
+}
+static inline region_box boxJoin(const region_box* a, const region_box* b)
+{
+    return (region_box){a->x0 < b->x0 ? a->x0 : b->x0, a->y0 < b->y0 ? a->y0 : b->y0, a->z0 < b->z0 ? a->z0 : b->z0,
+                        a->x1 > b->x1 ? a->x1 : b->x1, a->y1 > b->y1 ? a->y1 : b->y1, a->z1 > b->z1 ? a->z1 : b->z1};
+}
+// `b` joins a box in `list` that it touches or starts its own, once there
+// are EDIT_BOXES it joins whichever it grows least
+void boxAdd(region_box* list, uint* n, const region_box* b)
+{
+    for(uint i = 0; i < *n; i++)
+    {
+        const region_box* a = &list[i];
+        if(b->x0 <= a->x1+1 && a->x0 <= b->x1+1 && b->y0 <= a->y1+1 && a->y0 <= b->y1+1 && b->z0 <= a->z1+1 && a->z0 <= b->z1+1)
+        {
+            list[i] = boxJoin(a, b);
+            return;
+        }
+    }
+    if(*n < EDIT_BOXES){list[(*n)++] = *b; return;}
+    uint best = 0, grow = 0xFFFFFFFF;
+    for(uint i = 0; i < *n; i++)
+    {
+        const region_box j = boxJoin(&list[i], b);
+        const uint d = regionVolume(&j) - regionVolume(&list[i]);
+        if(d < grow){grow = d, best = i;}
+    }
+    list[best] = boxJoin(&list[best], b);
+}
+
+// voxels lo to hi changed this frame
+void markDirty(const uint lo, const uint hi)
+{
+    if(lo < edit_lo){edit_lo = lo;}
+    if(hi > edit_hi){edit_hi = hi;}
+    const region_box b = spanBox(lo, hi);
+    boxAdd(edit_boxes, &edit_nboxes, &b);
+}
+// set voxel i of `s` to v, returns 1 if it changed
+uint editVoxel(game_state* s, const uint i, const uchar v)
+{
+    if(s->voxels[i] == v){return 0;}
+    s->voxels[i] = v;
+    markDirty(i, i);
+    return 1;
+}
+// set n voxels from i along the PTI() order, returns the voxels changed
+uint editSpan(game_state* s, const uint i, const uint n, const uchar v)
+{
+    uint c = 0;
+    uchar* p = &s->voxels[i];
+    for(uint x = 0; x < n; x++){c += p[x] != v;}
+    memset(p, v, n);
+    if(c > 0){markDirty(i, i+n-1);}
+    return c;
+}
+// the empty voxels of the span take v, like a click places
+uint editPlace(game_state* s, const uint i, const uint n, const uchar v)
+{
+    uint c = 0;
+    uchar* p = &s->voxels[i];
+    for(uint x = 0; x < n; x++)
+    {
+        c += p[x] == 0;
+        p[x] = p[x] == 0 ? v : p[x];
+    }
+    if(c > 0){markDirty(i, i+n-1);}
+    return c;
+}
+// the filled voxels of the span take v
+uint editPaint(game_state* s, const uint i, const uint n, const uchar v)
+{
+    uint c = 0;
+    uchar* p = &s->voxels[i];
+    for(uint x = 0; x < n; x++)
+    {
+        c += p[x] != 0 && p[x] != v;
+        p[x] = p[x] != 0 ? v : 0;
+    }
+    if(c > 0){markDirty(i, i+n-1);}
+    return c;
+}
+// the voxels of the span that are `from` take v
+uint editReplace(game_state* s, const uint i, const uint n, const uchar from, const uchar v)
+{
+    if(from == v){return 0;}
+    uint c = 0;
+    uchar* p = &s->voxels[i];
+    for(uint x = 0; x < n; x++)
+    {
+        c += p[x] == from;
+        p[x] = p[x] == from ? v : p[x];
+    }
+    if(c > 0){markDirty(i, i+n-1);}
+    return c;
+}
+// copy n voxels from `src` to i, only the part that differs is marked
+uint editCopy(game_state* s, const uint i, const uchar* src, const uint n)
+{
+    uint c = 0;
+    uchar* p = &s->voxels[i];
+    for(uint x = 0; x < n; x++){c += p[x] != src[x];}
+    if(c == 0){return 0;}
+    uint a = 0, b = n-1;
+    while(p[a] == src[a]){a++;}
+    while(p[b] == src[b]){b--;}
+    memcpy(p+a, src+a, b-a+1);
+    markDirty(i+a, i+b);
+    return c;
+}
+// set the box x0..x1, y0..y1, z0..z1 inclusive, returns the voxels changed
+uint editBox(game_state* s, const uint x0, const uint y0, const uint z0, const uint x1, const uint y1, const uint z1, const uchar v)
+{
+    uint c = 0;
+    for(uint z = z0; z <= z1; z++)
+        for(uint y = y0; y <= y1; y++)
+            c += editSpan(s, PTI(x0, y, z), x1-x0+1, v);
+    return c;
+}
+// pass the frame's change set on, once a frame and before an undo record closes
+void editFlush()
+{
+    edit_changed = 0;
+    if(edit_lo > edit_hi){return;}
+    edit_aabb = edit_boxes[0];
+    for(uint i = 0; i < edit_nboxes; i++)
+    {
+        boxAdd(dirty_boxes, &dirty_nboxes, &edit_boxes[i]);
+        edit_aabb = boxJoin(&edit_aabb, &edit_boxes[i]);
+    }
+    edit_changed = 1;
+    if(edit_lo < undo_lo){undo_lo = edit_lo;}
+    if(edit_hi > undo_hi){undo_hi = edit_hi;}
+    journal_aabb = edit_unsaved == 1 ? boxJoin(&journal_aabb, &edit_aabb) : edit_aabb;
+    edit_unsaved = 1;
+    edit_lo = EDIT_NONE, edit_hi = 0, edit_nboxes = 0;
+}
+// voxel i is texel (i/2048, i%2048), a z slab is 8 texture columns of
+// 16 y rows each, so a box is a rectangle per slab and one rectangle for
+// all of them when it spans the whole of y. GLES2 has no
+// UNPACK_ROW_LENGTH so each is packed first, returns the bytes sent
+static size_t voxelRect(Uint32* px, const uint c0, const uint c1, const uint r0, const uint r1)
+{
+    const uint w = c1-c0+1, h = r1-r0+1;
+    for(uint y = 0; y < h; y++)
+    {
+        Uint32* d = px + y*w;
+        for(uint x = 0; x < w; x++)
+        {
+            d[x] = voxelTexel(g.voxels[(c0+x)*2048 + r0+y]);
+            setpixel(sVoxel, c0+x, r0+y, d[x]); // keep the full copy in step
+        }
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, c0, r0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, px);
+    return (size_t)w*h*4;
+}
+// upload the dirty boxes to `tex` and reset them, returns the bytes sent
+size_t updateVoxelRegion(const GLuint tex)
+{
+    static Uint32* px = NULL;
+    if(dirty_nboxes == 0){return 0;}
+    if(px == NULL){px = malloc(1024*2048*4);}
+    if(px == NULL){has_changed = 1; return 0;}
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    size_t bytes = 0;
+    for(uint i = 0; i < dirty_nboxes; i++)
+    {
+        const region_box* b = &dirty_boxes[i];
+        const uint b0 = b->y0 >> 4, b1 = b->y1 >> 4; // the slab's columns
+        const uint r0 = b0 == b1 ? ((b->y0 & 15) << 7) + b->x0 : b->x0;
+        const uint r1 = b0 == b1 ? ((b->y1 & 15) << 7) + b->x1 : 1920 + b->x1;
+        if(b0 == 0 && b1 == 7){bytes += voxelRect(px, b->z0*8, b->z1*8+7, r0, r1); continue;}
+        for(uint z = b->z0; z <= b->z1; z++){bytes += voxelRect(px, z*8+b0, z*8+b1, r0, r1);}
+    }
+    dirty_nboxes = 0;
+    return bytes;
+}
 
 //*************************************
 // Simple Font
@@ -0,0 +1,1039 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Export functions.
+
+    Every exporter reads from the game_state it is handed rather than
+    the global `g`, this way the batch exporter can load and convert
+    many projects at once on a small pool of worker threads.
+*/
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#ifdef __linux__
+    #include <glob.h>
+    #include <sys/stat.h>
+#endif
+#ifdef _WIN32
+    #include <io.h>
+    #define dup _dup
+    #define dup2 _dup2
+    #define close _close
+#else
+    #include <unistd.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+#include <stdarg.h>
+
+//*************************************
+// export formats
+//*************************************
+#define EXPORT_WOX 0
+#define EXPORT_TXT 1
+#define EXPORT_VV  2
+#define EXPORT_PLY 3
+#define EXPORT_GLB 4
+#define EXPORT_MAX 5
+#define LOD_MAX 8 // levels in a lod chain, see exportLOD()
+const char* export_names[EXPORT_MAX] = {"wox", "txt", "vv", "ply", "glb"};
+const char* export_exts[EXPORT_MAX] = {".wox.gz", ".txt", ".vv.txt", ".ply", ".glb"};
+const char* export_labels[EXPORT_MAX] = {"WOX", "TXT", "VV", "PLY", "GLB"};
+int exportType(const char* name)
+{
+    for(int i = 0; i < EXPORT_MAX; i++)
+        if(strcmp(name, export_names[i]) == 0){return i;}
+    return -1;
+}
+
+// voxel face rendering for ply, s is half the voxel size
+void fw_mx(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g -1 0 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
+}
+void fw_px(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 1 0 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
+}
+//
+void fw_my(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 -1 0 %u %u %u\n", x-s, y-s, z-s, r, g, b);
+}
+void fw_py(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x-s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 1 0 %u %u %u\n", x+s, y+s, z-s, r, g, b);
+}
+//
+void fw_mz(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y+s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x+s, y-s, z-s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 -1 %u %u %u\n", x-s, y-s, z-s, r, g, b);
+}
+void fw_pz(FILE* f, float x, float y, float z, const float s, uchar r, uchar g, uchar b)
+{
+    x -= 64.f, y -= 64.f;
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y+s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x-s, y-s, z+s, r, g, b);
+    fprintf(f, "%g %g %g 0 0 1 %u %u %u\n", x+s, y-s, z+s, r, g, b);
+}
+
+//*************************************
+// visible voxel classification
+//*************************************
+// every (y,z) row of 128 voxels is packed into a 128 bit occupancy mask,
+// exposed faces then fall out of shifts (x neighbours) and and-nots
+// against the neighbouring rows (y and z neighbours). out of bounds
+// counts as empty, same as the old per voxel PTIB2() checks.
+typedef struct
+{
+    uint64_t occ[128][128][2];      // [z][y] one bit per x, voxel != 0
+    uint64_t sol[128][128][2];      // exportable voxels, user colored and not black
+    uint64_t face[6][128][128][2];  // exposed faces of exportable voxels, -x +x -y +y -z +z
+    uint64_t vis[128][128][2];      // exportable voxels with at least one exposed face
+}
+voxel_masks;
+void vmRow(const uchar* p, const uchar hi, uint64_t* occ, uint64_t* sol)
+{
+    // occ = p[x] != 0, sol = 8 <= p[x] <= hi
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo8 = _mm256_set1_epi8(8);
+    const __m256i hiv = _mm256_set1_epi8(hi);
+    for(uint i = 0; i < 4; i++)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(p + i*32));
+        const uint64_t o = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        const __m256i in = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lo8), v),
+                                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, hiv), v));
+        const uint64_t r = (uint32_t)_mm256_movemask_epi8(in);
+        occ[i>>1] |= (o & 0xFFFFFFFF) << ((i&1)*32);
+        sol[i>>1] |= r << ((i&1)*32);
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo8 = _mm_set1_epi8(8);
+    const __m128i hiv = _mm_set1_epi8(hi);
+    for(uint i = 0; i < 8; i++)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(p + i*16));
+        const uint64_t o = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF;
+        const __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lo8), v),
+                                         _mm_cmpeq_epi8(_mm_min_epu8(v, hiv), v));
+        const uint64_t r = _mm_movemask_epi8(in);
+        occ[i>>2] |= o << ((i&3)*16);
+        sol[i>>2] |= r << ((i&3)*16);
+    }
+#else
+    for(uint x = 0; x < 128; x++)
+    {
+        occ[x>>6] |= (uint64_t)(p[x] != 0) << (x&63);
+        sol[x>>6] |= (uint64_t)(p[x] >= 8 && p[x] <= hi) << (x&63);
+    }
+#endif
+}
+void voxelMasks(voxel_masks* m, const game_state* s)
+{
+    memset(m, 0, sizeof(voxel_masks));
+
+    // exportable colors are almost always one run from 8 upwards (palettes
+    // are filled from the top) which can be range tested 32 voxels at a time,
+    // anything odd such as black in the middle of a palette goes the slow way.
+    uchar ex[256] = {0};
+    for(uint v = 8; v < 40; v++){ex[v] = (s->colors[v-1] & 0x00FFFFFF) != 0;}
+    uint hi = 7;
+    while(hi < 39 && ex[hi+1] == 1){hi++;}
+    uint run = 1;
+    for(uint v = hi+1; v < 40; v++){if(ex[v] == 1){run = 0;}}
+
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            const uchar* p = &s->voxels[PTI(0,y,z)];
+            if(run == 1){vmRow(p, hi, m->occ[z][y], m->sol[z][y]);}
+            else
+            {
+                vmRow(p, 7, m->occ[z][y], m->sol[z][y]);
+                for(uint x = 0; x < 128; x++)
+                    m->sol[z][y][x>>6] |= (uint64_t)ex[p[x]] << (x&63);
+            }
+        }
+    }
+
+    static const uint64_t empty[2] = {0, 0};
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            const uint64_t* o = m->occ[z][y];
+            const uint64_t* sv = m->sol[z][y];
+            const uint64_t* ym = y > 0   ? m->occ[z][y-1] : empty;
+            const uint64_t* yp = y < 127 ? m->occ[z][y+1] : empty;
+            const uint64_t* zm = z > 0   ? m->occ[z-1][y] : empty;
+            const uint64_t* zp = z < 127 ? m->occ[z+1][y] : empty;
+            // the neighbour at x-1 shifted up into x, and x+1 down into x
+            const uint64_t xm[2] = {o[0] << 1, (o[1] << 1) | (o[0] >> 63)};
+            const uint64_t xp[2] = {(o[0] >> 1) | (o[1] << 63), o[1] >> 1};
+            for(uint h = 0; h < 2; h++)
+            {
+                m->face[0][z][y][h] = sv[h] & ~xm[h];
+                m->face[1][z][y][h] = sv[h] & ~xp[h];
+                m->face[2][z][y][h] = sv[h] & ~ym[h];
+                m->face[3][z][y][h] = sv[h] & ~yp[h];
+                m->face[4][z][y][h] = sv[h] & ~zm[h];
+                m->face[5][z][y][h] = sv[h] & ~zp[h];
+                m->vis[z][y][h] = m->face[0][z][y][h] | m->face[1][z][y][h] | m->face[2][z][y][h] |
+                                  m->face[3][z][y][h] | m->face[4][z][y][h] | m->face[5][z][y][h];
+            }
+        }
+    }
+}
+uint voxelFaces(const voxel_masks* m, const uint x, const uint y, const uint z)
+{
+    // exposed faces of one voxel as 6 bits, -x first
+    uint r = 0;
+    for(uint f = 0; f < 6; f++)
+        r |= ((m->face[f][z][y][x>>6] >> (x&63)) & 1) << f;
+    return r;
+}
+// walk the set bits of a row in ascending x
+#define forEachBit(row, x) \
+    for(uint64_t _h = 0, _b = (row)[0]; _h < 2; _h++, _b = _h < 2 ? (row)[1] : 0) \
+        for(uint x; _b != 0 && (x = __builtin_ctzll(_b) + _h*64, 1); _b &= _b-1)
+
+//*************************************
+// exporters
+//*************************************
+void voxelRGB(const game_state* s, const uint x, const uint y, const uint z, uchar* r, uchar* gc, uchar* b)
+{
+    const uint tu = s->colors[s->voxels[PTI(x,y,z)]-1];
+    *r = (tu & 0x00FF0000) >> 16;
+    *gc = (tu & 0x0000FF00) >> 8;
+    *b = (tu & 0x000000FF);
+}
+void exportTXT(FILE* f, const game_state* s, const voxel_masks* m)
+{
+    fprintf(f, "# %s %s\n", appTitle, appVersion);
+    fprintf(f, "# X Y Z RRGGBB\n");
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            forEachBit(m->sol[z][y], x)
+            {
+                uchar r, gc, b;
+                voxelRGB(s, x, y, z, &r, &gc, &b);
+                fprintf(f, "%i %i %i %02X%02X%02X\n", ((int)x)-64, ((int)y)-64, z, r, gc, b);
+            }
+        }
+    }
+}
+void exportVV(FILE* f, const game_state* s, const voxel_masks* m)
+{
+    fprintf(f, "# %s %s - Visible Voxels only\n", appTitle, appVersion);
+    fprintf(f, "# X Y Z RRGGBB\n");
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            forEachBit(m->vis[z][y], x)
+            {
+                uchar r, gc, b;
+                voxelRGB(s, x, y, z, &r, &gc, &b);
+                fprintf(f, "%i %i %i %02X%02X%02X\n", ((int)x)-64, ((int)y)-64, z, r, gc, b);
+            }
+        }
+    }
+}
+void plyWrite(FILE* f, const game_state* s, const voxel_masks* m, const uint lod)
+{
+    // a lod level is a grid downsampled `lod` times, scale it back up
+    const float vs = (float)(1 << lod);
+    const float vo = (vs-1.f)*0.5f;
+    // the face masks give the vertex count up front, so the header
+    // can be written before any of the body is streamed out
+    uint vc = 0;
+    for(uint i = 0; i < 6; i++)
+        for(uint z = 0; z < 128; z++)
+            for(uint y = 0; y < 128; y++)
+                vc += (__builtin_popcountll(m->face[i][z][y][0]) + __builtin_popcountll(m->face[i][z][y][1])) * 6;
+    fprintf(f, "ply\n");
+    fprintf(f, "format ascii 1.0\n");
+    fprintf(f, "comment Created by %s %s - woxels.github.io\n", appTitle, appVersion);
+    fprintf(f, "element vertex %u\n", vc);
+    fprintf(f, "property float x\n");
+    fprintf(f, "property float y\n");
+    fprintf(f, "property float z\n");
+    fprintf(f, "property float nx\n");
+    fprintf(f, "property float ny\n");
+    fprintf(f, "property float nz\n");
+    fprintf(f, "property uchar red\n");
+    fprintf(f, "property uchar green\n");
+    fprintf(f, "property uchar blue\n");
+    const uint faces = vc/3;
+    fprintf(f, "element face %u\n", faces);
+    fprintf(f, "property list uchar uint vertex_indices\n");
+    fprintf(f, "end_header\n");
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            forEachBit(m->vis[z][y], x)
+            {
+                uchar cr, cg, cb;
+                voxelRGB(s, x, y, z, &cr, &cg, &cb);
+                const uint fm = voxelFaces(m, x, y, z);
+                const float wx = x*vs+vo, wy = y*vs+vo, wz = z*vs+vo, hs = vs*0.5f;
+                if(fm &  1){fw_mx(f, wx, wy, wz, hs, cr, cg, cb);}
+                if(fm &  2){fw_px(f, wx, wy, wz, hs, cr, cg, cb);}
+                if(fm &  4){fw_my(f, wx, wy, wz, hs, cr, cg, cb);}
+                if(fm &  8){fw_py(f, wx, wy, wz, hs, cr, cg, cb);}
+                if(fm & 16){fw_mz(f, wx, wy, wz, hs, cr, cg, cb);}
+                if(fm & 32){fw_pz(f, wx, wy, wz, hs, cr, cg, cb);}
+            }
+        }
+    }
+    // merge vertices by distance in Blender or `Cleaning and Repairing > Merge Close Vertices` in MeshLab
+    for(int i = 0, t = 0; i < faces; i++)
+    {
+        const int i1 = t++;
+        const int i2 = t++;
+        const int i3 = t++;
+        fprintf(f, "3 %i %i %i\n", i1, i2, i3);
+    }
+}
+void exportPLY(FILE* f, const game_state* s, const voxel_masks* m)
+{
+    plyWrite(f, s, m, 0);
+}
+
+//*************************************
+// glb export
+//*************************************
+// binary glTF 2.0, y-up, one indexed quad per exposed voxel face.
+// positions are int16 voxel corners (KHR_mesh_quantization), normals are
+// normalized int8 and the uv is a normalized uint8 index into a 64x1
+// palette texture built from the project colors.
+typedef struct
+{
+    uchar* data;
+    size_t len, cap;
+    uint err;   // an allocation failed, the buffer is short and must not be written
+}
+export_buf;
+void ebPut(export_buf* b, const void* d, const size_t n)
+{
+    if(b->err == 1){return;}
+    if(b->len+n > b->cap)
+    {
+        size_t nc = b->cap == 0 ? 65536 : b->cap*2;
+        while(b->len+n > nc){nc *= 2;}
+        uchar* nd = realloc(b->data, nc);
+        if(nd == NULL){b->err = 1; return;}
+        b->data = nd, b->cap = nc;
+    }
+    memcpy(b->data + b->len, d, n);
+    b->len += n;
+}
+void ebAlign(export_buf* b, const uchar pad)
+{
+    while(b->len % 4 != 0){ebPut(b, &pad, 1);}
+}
+#pragma pack(push, 1)
+typedef struct
+{
+    short px, py, pz, pad0;
+    signed char nx, ny, nz, pad1;
+    uchar u, v, pad2, pad3;
+}
+glb_vertex; // 16 byte stride, every attribute 4 byte aligned as the spec asks
+#pragma pack(pop)
+typedef struct
+{
+    export_buf vb, ib;  // vertices, uint32 indices
+    uint nv, ni;
+    short min[3], max[3];
+}
+glb_mesh;
+// quad origin and tangents per face in woxel space, u x v points out of the face
+const signed char glb_face[6][9] = {
+    {0,0,0,  0,0,1,  0,1,0},  // -x
+    {1,0,0,  0,1,0,  0,0,1},  // +x
+    {0,0,0,  1,0,0,  0,0,1},  // -y
+    {0,1,0,  0,0,1,  1,0,0},  // +y
+    {0,0,0,  0,1,0,  1,0,0},  // -z
+    {0,0,1,  1,0,0,  0,1,0},  // +z
+};
+const signed char glb_normal[6][3] = {{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,-1},{0,0,1}};
+void glbFace(glb_mesh* m, const int x, const int y, const int z, const uint face, const uchar color)
+{
+    const signed char* f = glb_face[face];
+    const signed char* n = glb_normal[face];
+    // palette texel center as a normalized uint8
+    const uchar u = (uchar)(((color+0.5f)/64.f)*255.f + 0.5f);
+    for(uint i = 0; i < 4; i++)
+    {
+        const int cx = x + f[0] + (i == 1 || i == 2 ? f[3] : 0) + (i >= 2 ? f[6] : 0);
+        const int cy = y + f[1] + (i == 1 || i == 2 ? f[4] : 0) + (i >= 2 ? f[7] : 0);
+        const int cz = z + f[2] + (i == 1 || i == 2 ? f[5] : 0) + (i >= 2 ? f[8] : 0);
+        glb_vertex v = {0};
+        // woxel is z-up, gltf is y-up: (x, y, z) -> (x, z, -y)
+        v.px = cx-64, v.py = cz, v.pz = -(cy-64);
+        v.nx = n[0]*127, v.ny = n[2]*127, v.nz = -n[1]*127;
+        v.u = u;
+        const short p[3] = {v.px, v.py, v.pz};
+        for(uint j = 0; j < 3; j++)
+        {
+            if(m->nv == 0 || p[j] < m->min[j]){m->min[j] = p[j];}
+            if(m->nv == 0 || p[j] > m->max[j]){m->max[j] = p[j];}
+        }
+        ebPut(&m->vb, &v, sizeof(glb_vertex));
+        m->nv++;
+    }
+    const uint b = m->nv-4;
+    const uint idx[6] = {b, b+1, b+2, b, b+2, b+3};
+    ebPut(&m->ib, idx, sizeof(idx));
+    m->ni += 6;
+}
+void glbMesh(glb_mesh* m, const game_state* s, const voxel_masks* vm)
+{
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            forEachBit(vm->vis[z][y], x)
+            {
+                const uchar c = s->voxels[PTI(x,y,z)]-1;
+                const uint fm = voxelFaces(vm, x, y, z);
+                for(uint i = 0; i < 6; i++)
+                    if(fm & (1 << i)){glbFace(m, x, y, z, i, c);}
+            }
+        }
+    }
+}
+void ebPrintf(export_buf* b, const char* fmt, ...)
+{
+    char tmp[1024];
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(tmp, 1024, fmt, args);
+    va_end(args);
+    ebPut(b, tmp, n);
+}
+// returns 0 when a mesh or the file ran out of memory, nothing is written then
+uint glbWrite(FILE* f, const game_state* s, glb_mesh* m, const uint n)
+{
+    for(uint i = 0; i < n; i++){if(m[i].vb.err == 1 || m[i].ib.err == 1){return 0;}}
+    // meshes after the first are a lod chain, mesh i built from a
+    // grid downsampled i times so it is scaled back up by 2^i. Empty
+    // meshes are left out, glTF has no valid zero length accessor.
+    uint lv[LOD_MAX], k = 0;
+    for(uint i = 0; i < n && i < LOD_MAX; i++){if(m[i].ni > 0){lv[k++] = i;}}
+    export_buf bin = {0};
+    export_buf js = {0};
+    ebPrintf(&js, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"%s %s - woxels.github.io\"},", appTitle, appVersion);
+    if(k == 0) // nothing to draw, an empty scene and no bin chunk
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] No visible voxels, the glb is an empty scene.\n", tmp);
+        ebPrintf(&js, "\"scene\":0,\"scenes\":[{}]}");
+        ebAlign(&js, ' ');
+        if(js.err == 1){free(js.data); return 0;}
+        const uint hdr[5] = {0x46546C67, 2, 12+8+js.len, js.len, 0x4E4F534A};
+        fwrite(hdr, 1, sizeof(hdr), f);
+        fwrite(js.data, 1, js.len, f);
+        free(js.data);
+        return 1;
+    }
+    if(k > 1){ebPrintf(&js, "\"extensionsUsed\":[\"KHR_mesh_quantization\",\"MSFT_lod\"],");}
+    else{ebPrintf(&js, "\"extensionsUsed\":[\"KHR_mesh_quantization\"],");}
+    ebPrintf(&js, "\"extensionsRequired\":[\"KHR_mesh_quantization\"],\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[");
+    for(uint i = 0; i < k; i++)
+    {
+        const float sc = (float)(1 << lv[i]);
+        ebPrintf(&js, "%s{\"mesh\":%u,", i == 0 ? "" : ",", i);
+        if(lv[i] == 0){ebPrintf(&js, "\"translation\":[-0.5,-0.5,0.5]");}
+        else{ebPrintf(&js, "\"scale\":[%g,%g,%g],\"translation\":[%g,-0.5,%g]", sc, sc, sc, 64.f*sc-64.5f, -64.f*sc+64.5f);}
+        if(i == 0 && k > 1)
+        {
+            ebPrintf(&js, ",\"extensions\":{\"MSFT_lod\":{\"ids\":[");
+            for(uint j = 1; j < k; j++){ebPrintf(&js, "%s%u", j == 1 ? "" : ",", j);}
+            ebPrintf(&js, "]}},\"extras\":{\"MSFT_screencoverage\":[");
+            for(uint j = 0; j < k; j++){ebPrintf(&js, "%s%g", j == 0 ? "" : ",", 0.5f/(float)(1 << lv[j]));}
+            ebPrintf(&js, "]}");
+        }
+        if(n > 1){ebPrintf(&js, ",\"name\":\"LOD%u\"", lv[i]);}
+        ebPrintf(&js, "}");
+    }
+    ebPrintf(&js, "],\"meshes\":[");
+    for(uint i = 0; i < k; i++)
+        ebPrintf(&js, "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"NORMAL\":%u,\"TEXCOORD_0\":%u},\"indices\":%u,\"material\":0}]}", i == 0 ? "" : ",", i*4, i*4+1, i*4+2, i*4+3);
+    ebPrintf(&js, "],\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0},\"metallicFactor\":0,\"roughnessFactor\":1}}],"
+        "\"textures\":[{\"sampler\":0,\"source\":0}],"
+        "\"samplers\":[{\"magFilter\":9728,\"minFilter\":9728,\"wrapS\":33071,\"wrapT\":33071}],"
+        "\"images\":[{\"bufferView\":%u,\"mimeType\":\"image/png\"}],\"accessors\":[", k*2);
+
+    export_buf views = {0};
+    for(uint i = 0; i < k; i++)
+    {
+        const glb_mesh* mi = &m[lv[i]];
+        const size_t voff = bin.len;
+        ebPut(&bin, mi->vb.data, mi->vb.len);
+
+        // 16 bit indices when they fit
+        const size_t ioff = bin.len;
+        const uint wide = mi->nv > 65535;
+        if(wide == 1){ebPut(&bin, mi->ib.data, mi->ib.len);}
+        else
+        {
+            const uint* idx = (uint*)mi->ib.data;
+            for(uint j = 0; j < mi->ni; j++)
+            {
+                const unsigned short i16 = idx[j];
+                ebPut(&bin, &i16, 2);
+            }
+        }
+        const size_t ilen = bin.len - ioff;
+        ebAlign(&bin, 0);
+
+        ebPrintf(&js, "%s{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5122,\"count\":%u,\"type\":\"VEC3\",\"min\":[%i,%i,%i],\"max\":[%i,%i,%i]},",
+            i == 0 ? "" : ",", i*2, mi->nv, mi->min[0], mi->min[1], mi->min[2], mi->max[0], mi->max[1], mi->max[2]);
+        ebPrintf(&js, "{\"bufferView\":%u,\"byteOffset\":8,\"componentType\":5120,\"normalized\":true,\"count\":%u,\"type\":\"VEC3\"},", i*2, mi->nv);
+        ebPrintf(&js, "{\"bufferView\":%u,\"byteOffset\":12,\"componentType\":5121,\"normalized\":true,\"count\":%u,\"type\":\"VEC2\"},", i*2, mi->nv);
+        ebPrintf(&js, "{\"bufferView\":%u,\"componentType\":%u,\"count\":%u,\"type\":\"SCALAR\"}", i*2+1, wide ? 5125 : 5123, mi->ni);
+        ebPrintf(&views, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"byteStride\":16,\"target\":34962},", voff, mi->vb.len);
+        ebPrintf(&views, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963},", ioff, ilen);
+    }
+
+    // palette texture
+    uchar pal[64*3] = {0};
+    for(uint i = 0; i < 39; i++)
+    {
+        pal[i*3]   = (s->colors[i] & 0x00FF0000) >> 16;
+        pal[i*3+1] = (s->colors[i] & 0x0000FF00) >> 8;
+        pal[i*3+2] = (s->colors[i] & 0x000000FF);
+    }
+    size_t plen;
+    uchar* png = pngEncode(pal, 64, 1, 3, &plen);
+    const size_t poff = bin.len;
+    if(png == NULL){bin.err = 1;}
+    else{ebPut(&bin, png, plen);}
+    free(png);
+    ebAlign(&bin, 0);
+
+    ebPrintf(&js, "],\"bufferViews\":[");
+    ebPut(&js, views.data, views.len);
+    ebPrintf(&js, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],\"buffers\":[{\"byteLength\":%zu}]}", poff, plen, bin.len);
+    ebAlign(&js, ' ');
+    const uint ok = bin.err == 0 && js.err == 0 && views.err == 0;
+    if(ok == 0){goto done;}
+
+    // header, json chunk, bin chunk
+    const uint hdr[5] = {0x46546C67, 2, 12+8+js.len+8+bin.len, js.len, 0x4E4F534A};
+    fwrite(hdr, 1, sizeof(hdr), f);
+    fwrite(js.data, 1, js.len, f);
+    const uint bhdr[2] = {bin.len, 0x004E4942};
+    fwrite(bhdr, 1, sizeof(bhdr), f);
+    fwrite(bin.data, 1, bin.len, f);
+
+done:
+    free(views.data);
+    free(js.data);
+    free(bin.data);
+    return ok;
+}
+void glbFree(glb_mesh* m)
+{
+    free(m->vb.data);
+    free(m->ib.data);
+    memset(m, 0, sizeof(glb_mesh));
+}
+uint exportGLB(FILE* f, const game_state* s, const voxel_masks* vm)
+{
+    glb_mesh m;
+    memset(&m, 0, sizeof(glb_mesh));
+    glbMesh(&m, s, vm);
+    const uint r = glbWrite(f, s, &m, 1);
+    glbFree(&m);
+    return r;
+}
+
+//*************************************
+// export streams
+//*************************************
+// `-` is stdout and `-<fd>` is an already open file descriptor, such as
+// `-3` for `3>file` or a pipe handed down by a parent process. Nothing
+// is ever seeked so the output can go straight into another program.
+#define EXPORT_BUFFER 1048576
+int export_stdout = 1; // where stdout really is once the console output has been moved to stderr
+int exportFD(const char* path)
+{
+    if(path[0] != '-'){return -1;}
+    if(path[1] == 0x00){return export_stdout;}
+    if(path[1] < '0' || path[1] > '9'){return -1;}
+    const int fd = atoi(path+1);
+    return fd == 1 ? export_stdout : fd;
+}
+void exportRedirect(const char* path)
+{
+    // console chatter would end up in the middle of the data, so keep
+    // a private handle on stdout and send everything else to stderr
+    if(exportFD(path) != 1){return;}
+    fflush(stdout);
+    const int fd = dup(1);
+    if(fd < 0){return;}
+    if(dup2(2, 1) < 0){close(fd); return;}
+    export_stdout = fd;
+}
+FILE* exportOpen(const char* path)
+{
+    FILE* f;
+    const int fd = exportFD(path);
+    if(fd < 0){f = fopen(path, "wb");}
+    else{f = fdopen(dup(fd), "wb");}
+    if(f != NULL){setvbuf(f, NULL, _IOFBF, EXPORT_BUFFER);}
+    return f;
+}
+uint exportWOX(const game_state* s, const char* path)
+{
+    const int fd = exportFD(path);
+    if(fd < 0){return writeState(s, path);}
+    gzFile f = gzdopen(dup(fd), "wb9hR");
+    if(f == Z_NULL){return 0;}
+    gzbuffer(f, EXPORT_BUFFER);
+    const int r = gzwrite(f, s, sizeof(game_state)) == sizeof(game_state);
+    gzclose(f);
+    return r;
+}
+uint exportState(const game_state* s, const voxel_masks* m, const uint type, const char* path)
+{
+    // pass the masks in when exporting several formats from the same state,
+    // or NULL to have them classified just for this export
+    if(type == EXPORT_WOX){return exportWOX(s, path);}
+    FILE* f = exportOpen(path);
+    if(f == NULL){return 0;}
+    PROF_BEGIN(PROF_EXPORT);
+    voxel_masks* tm = NULL;
+    if(m == NULL)
+    {
+        tm = malloc(sizeof(voxel_masks));
+        if(tm == NULL){fclose(f); return 0;}
+        voxelMasks(tm, s);
+        m = tm;
+    }
+    uint w = 1; // glb builds in memory first and can run out
+    if     (type == EXPORT_TXT){exportTXT(f, s, m);}
+    else if(type == EXPORT_VV) {exportVV(f, s, m);}
+    else if(type == EXPORT_PLY){exportPLY(f, s, m);}
+    else if(type == EXPORT_GLB){w = exportGLB(f, s, m);}
+    free(tm);
+    const int r = ferror(f) == 0 && w == 1;
+    const int c = fclose(f) == 0;
+    PROF_END(PROF_EXPORT);
+    return c & r;
+}
+
+//*************************************
+// lod export
+//*************************************
+// each level halves the grid, a 2x2x2 block becomes one voxel of the
+// most common color when at least `threshold` of its 8 voxels are set.
+// system colors are editor guides and never make it into a lower level.
+// glb and ply levels are scaled back up to line up with the full model,
+// the voxel formats (wox, txt, vv) stay in the coordinates of their level.
+void lodDownsample(game_state* d, const game_state* s, const uint size, const uint threshold)
+{
+    memcpy(d->colors, s->colors, sizeof(s->colors));
+    memset(d->voxels, 0, max_voxels);
+    const uint h = size/2;
+    for(uint z = 0; z < h; z++)
+    {
+        for(uint y = 0; y < h; y++)
+        {
+            for(uint x = 0; x < h; x++)
+            {
+                uchar c[8];
+                uint n = 0;
+                for(uint i = 0; i < 8; i++)
+                {
+                    const uchar v = s->voxels[PTI(x*2+(i&1), y*2+((i>>1)&1), z*2+(i>>2))];
+                    if(v >= 8 && (s->colors[v-1] & 0x00FFFFFF) != 0){c[n++] = v;}
+                }
+                if(n == 0 || n < threshold){continue;}
+                // majority color, ties go to the first seen
+                uchar best = c[0];
+                uint bc = 0;
+                for(uint i = 0; i < n; i++)
+                {
+                    uint cc = 0;
+                    for(uint j = 0; j < n; j++){cc += c[j] == c[i];}
+                    if(cc > bc){bc = cc, best = c[i];}
+                }
+                d->voxels[PTI(x,y,z)] = best;
+            }
+        }
+    }
+}
+typedef struct
+{
+    const game_state* s;
+    uint type, lod;
+    char path[1536];  // non glb formats get a file per level
+    glb_mesh mesh;    // glb levels are gathered into one file
+    uint ok;
+}
+lod_level;
+int lodWorker(void* data)
+{
+    lod_level* l = data;
+    voxel_masks* m = malloc(sizeof(voxel_masks));
+    if(m == NULL){return 0;}
+    PROF_BEGIN(PROF_EXPORT);
+    voxelMasks(m, l->s);
+    if(l->type == EXPORT_GLB)
+    {
+        glbMesh(&l->mesh, l->s, m);
+        l->ok = l->mesh.vb.err == 0 && l->mesh.ib.err == 0;
+    }
+    else if(l->type == EXPORT_PLY)
+    {
+        FILE* f = exportOpen(l->path);
+        if(f != NULL)
+        {
+            plyWrite(f, l->s, m, l->lod);
+            l->ok = ferror(f) == 0;
+            l->ok &= fclose(f) == 0;
+        }
+    }
+    else{l->ok = exportState(l->s, m, l->type, l->path);}
+    free(m);
+    PROF_END(PROF_EXPORT);
+    return 0;
+}
+uint exportLOD(const game_state* s, const uint type, const char* path, uint levels, const uint threshold)
+{
+    if(levels < 1){levels = 1;}
+    if(levels > LOD_MAX){levels = LOD_MAX;}
+    if(type != EXPORT_GLB && levels > 1 && exportFD(path) >= 0)
+    {
+        printf("ERROR: only glb can stream more than one lod level.\n");
+        return 0;
+    }
+
+    // the chain itself is cheap, meshing and writing is where the time goes
+    game_state* st[LOD_MAX];
+    lod_level lv[LOD_MAX];
+    memset(lv, 0, sizeof(lv));
+    st[0] = (game_state*)s;
+    for(uint i = 1; i < levels; i++)
+    {
+        st[i] = malloc(sizeof(game_state));
+        if(st[i] == NULL){levels = i; break;}
+        lodDownsample(st[i], st[i-1], 128 >> (i-1), threshold);
+    }
+
+    // file.ply, file.lod1.ply, file.lod2.ply, ...
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    if(dot == NULL || (slash != NULL && dot < slash)){dot = path + strlen(path);}
+    SDL_Thread* th[LOD_MAX];
+    for(uint i = 0; i < levels; i++)
+    {
+        lv[i].s = st[i];
+        lv[i].type = type;
+        lv[i].lod = i;
+        if(i == 0){snprintf(lv[i].path, 1536, "%s", path);}
+        else{snprintf(lv[i].path, 1536, "%.*s.lod%u%s", (int)(dot-path), path, i, dot);}
+        th[i] = SDL_CreateThread(lodWorker, "lod", &lv[i]);
+        if(th[i] == NULL){lodWorker(&lv[i]);} // no thread, do it here
+    }
+    uint ok = 1;
+    for(uint i = 0; i < levels; i++)
+    {
+        SDL_WaitThread(th[i], NULL);
+        ok &= lv[i].ok;
+    }
+
+    if(type == EXPORT_GLB && ok == 1)
+    {
+        FILE* f = exportOpen(path);
+        if(f != NULL)
+        {
+            glb_mesh m[LOD_MAX];
+            for(uint i = 0; i < levels; i++){m[i] = lv[i].mesh;}
+            ok = glbWrite(f, s, m, levels);
+            ok &= ferror(f) == 0;
+            ok &= fclose(f) == 0;
+        }
+        else{ok = 0;}
+    }
+    for(uint i = 0; i < levels; i++){glbFree(&lv[i].mesh);}
+    for(uint i = 1; i < levels; i++){free(st[i]);}
+    return ok;
+}
+
+//*************************************
+// batch export
+//*************************************
+typedef struct
+{
+    char** files;           // project names or *.wox.gz paths
+    char** names;           // output name for each file, see batchNames()
+    uint nfiles, cap;
+    uint oom;               // an input could not be added, out of memory
+    uint types[EXPORT_MAX]; // requested formats
+    uint ntypes;
+    const char* outdir;
+    SDL_atomic_t next;      // next file to be claimed by a worker
+    SDL_atomic_t done;      // files exported
+    SDL_atomic_t failed;    // files that could not be loaded or written
+}
+batch_job;
+void batchAdd(batch_job* b, const char* file)
+{
+    if(b->oom == 1){return;}
+    if(b->nfiles == b->cap)
+    {
+        const uint nc = b->cap == 0 ? 256 : b->cap*2;
+        char** nf = realloc(b->files, nc*sizeof(char*));
+        if(nf == NULL){b->oom = 1; return;}
+        b->files = nf, b->cap = nc;
+    }
+    char* d = strdup(file);
+    if(d == NULL){b->oom = 1; return;}
+    b->files[b->nfiles++] = d;
+}
+void batchAddArg(batch_job* b, const char* arg)
+{
+    if(arg[0] == '@') // manifest, one project or path per line
+    {
+        FILE* f = fopen(arg+1, "r");
+        if(f == NULL){printf("ERROR: could not open manifest \"%s\".\n", arg+1); return;}
+        char line[1024];
+        while(fgets(line, 1024, f) != NULL)
+        {
+            line[strcspn(line, "\r\n")] = 0x00;
+            if(line[0] != 0x00 && line[0] != '#'){batchAdd(b, line);}
+        }
+        fclose(f);
+        return;
+    }
+#ifdef __linux__
+    if(strpbrk(arg, "*?[") != NULL) // quoted glob, saves blowing ARG_MAX on big asset trees
+    {
+        glob_t gl;
+        if(glob(arg, 0, NULL, &gl) == 0)
+            for(size_t i = 0; i < gl.gl_pathc; i++){batchAdd(b, gl.gl_pathv[i]);}
+        globfree(&gl);
+        return;
+    }
+#endif
+    batchAdd(b, arg);
+}
+// output names are the input file names minus the directory and .wox.gz,
+// inputs sharing one from different directories get _2, _3, ... so none
+// overwrite another, a small hash set spots the repeats
+uint batchHash(const char* s)
+{
+    uint h = 2166136261u;
+    while(*s != 0x00){h = (h ^ (uchar)*s++) * 16777619u;}
+    return h;
+}
+uint batchNames(batch_job* b)
+{
+    uint size = 64;
+    while(size < b->nfiles*4){size *= 2;}
+    b->names = calloc(b->nfiles, sizeof(char*));
+    char** set = calloc(size, sizeof(char*));
+    if(b->names == NULL || set == NULL){free(set); return 0;}
+    for(uint i = 0; i < b->nfiles; i++)
+    {
+        const char* in = b->files[i];
+        char name[256];
+        projectName(name, 256, in);
+
+        char out[272];
+        snprintf(out, 272, "%s", name);
+        uint h, k = 1;
+        while(1)
+        {
+            h = batchHash(out) & (size-1);
+            while(set[h] != NULL && strcmp(set[h], out) != 0){h = (h+1) & (size-1);}
+            if(set[h] == NULL){break;}
+            snprintf(out, 272, "%s_%u", name, ++k);
+        }
+        b->names[i] = strdup(out);
+        if(b->names[i] == NULL){free(set); return 0;}
+        set[h] = b->names[i];
+        if(k > 1)
+        {
+            char tmp[16];
+            timestamp(tmp);
+            printf("[%s] %s has the same name as an earlier input, exporting it as %s.\n", tmp, in, out);
+        }
+    }
+    free(set);
+    return 1;
+}
+void batchFree(batch_job* b)
+{
+    for(uint i = 0; i < b->nfiles; i++){free(b->files[i]); if(b->names != NULL){free(b->names[i]);}}
+    free(b->files);
+    free(b->names);
+}
+int batchWorker(void* data)
+{
+    batch_job* b = data;
+    game_state* s = malloc(sizeof(game_state));
+    voxel_masks* m = malloc(sizeof(voxel_masks));
+    if(s == NULL || m == NULL){free(s); free(m); return 0;}
+    while(1)
+    {
+        const int i = SDL_AtomicAdd(&b->next, 1);
+        if(i >= b->nfiles){break;}
+        const char* in = b->files[i];
+
+        char file[1024];
+        projectFile(file, 1024, in);
+
+        char tmp[16];
+        if(readState(s, file) == 0)
+        {
+            timestamp(tmp);
+            printf("[%s] Failed to load: %s\n", tmp, file);
+            SDL_AtomicAdd(&b->failed, 1);
+            continue;
+        }
+
+        const char* name = b->names[i];
+
+        // classify once, every format reuses the masks
+        voxelMasks(m, s);
+        uint ok = 1;
+        for(uint j = 0; j < b->ntypes; j++)
+        {
+            char out[1536];
+            snprintf(out, 1536, "%s/%s%s", b->outdir, name, export_exts[b->types[j]]);
+            if(exportState(s, m, b->types[j], out) == 0)
+            {
+                timestamp(tmp);
+                printf("[%s] Failed to write: %s\n", tmp, out);
+                ok = 0;
+            }
+        }
+        if(ok == 1)
+        {
+            SDL_AtomicAdd(&b->done, 1);
+            timestamp(tmp);
+            printf("[%s] Exported: %s\n", tmp, file);
+        }
+        else{SDL_AtomicAdd(&b->failed, 1);}
+    }
+    free(m);
+    free(s);
+    return 0;
+}
+// ./wox batch [-j<threads>] <formats,...> <output_dir> <project|file.wox.gz|'glob'|@manifest> ...
+int batchExport(int argc, char** argv)
+{
+    int a = 2;
+    uint threads = SDL_GetCPUCount();
+    if(argc > a && strncmp(argv[a], "-j", 2) == 0){threads = atoi(argv[a]+2); a++;}
+    if(threads < 1){threads = 1;}
+    if(threads > 64){threads = 64;}
+    if(argc < a+3)
+    {
+        printf("Usage: ./wox batch [-j<threads>] <formats: wox,txt,vv,ply,glb> <output_dir> <project|file.wox.gz|'glob'|@manifest> ...\n");
+        return 1;
+    }
+
+    batch_job b;
+    memset(&b, 0, sizeof(batch_job));
+    char fmts[256];
+    snprintf(fmts, 256, "%s", argv[a++]);
+    for(char* tok = strtok(fmts, ","); tok != NULL && b.ntypes < EXPORT_MAX; tok = strtok(NULL, ","))
+    {
+        const int type = exportType(tok);
+        if(type < 0){printf("ERROR: unknown export format \"%s\".\n", tok); return 1;}
+        b.types[b.ntypes++] = type;
+    }
+    b.outdir = argv[a++];
+    for(NULL; a < argc; a++){batchAddArg(&b, argv[a]);}
+    if(b.oom == 1 || (b.nfiles > 0 && batchNames(&b) == 0))
+    {
+        printf("ERROR: out of memory gathering the inputs.\n");
+        batchFree(&b);
+        return 1;
+    }
+    if(b.nfiles == 0){printf("ERROR: nothing to export.\n"); return 1;}
+    if(threads > b.nfiles){threads = b.nfiles;}
+
+#ifdef __linux__
+    mkdir(b.outdir, 0755);
+    setlocale(LC_NUMERIC, "");
+    const uint64_t st = microtime();
+#endif
+    SDL_Thread* pool[64];
+    uint started = 0;
+    for(uint i = 0; i < threads; i++)
+    {
+        pool[started] = SDL_CreateThread(batchWorker, "batch", &b);
+        if(pool[started] != NULL){started++;}
+    }
+    if(started == 0){batchWorker(&b);} // no threads at all, export them here
+    for(uint i = 0; i < started; i++){SDL_WaitThread(pool[i], NULL);}
+    threads = started == 0 ? 1 : started;
+    const uint done = SDL_AtomicGet(&b.done);
+
+    char tmp[16];
+    timestamp(tmp);
+#ifndef __linux__
+    printf("[%s] Batch exported %u of %u projects.\n", tmp, done, b.nfiles);
+#else
+    printf("[%s] Batch exported %'u of %'u projects on %u threads. (%'lu μs)\n", tmp, done, b.nfiles, threads, microtime()-st);
+#endif
+    const uint n = b.nfiles;
+    batchFree(&b);
+    return done == n ? 0 : 1;
+}
+
+#endif
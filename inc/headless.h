@@ -0,0 +1,381 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Headless functions.
+
+    Runs the real f0 shader without a window or a display server, on a
+    surfaceless EGL context (or a tiny pbuffer where surfaceless contexts
+    are missing) drawing into a framebuffer object, then reads the frame
+    back. Works on Mesa llvmpipe, so CI and render farms get images from
+    the same shader as the editor.
+
+    `./wox turntable` loads and uploads the volume once and renders a ring
+    of views, drawing the next view into the second framebuffer before the
+    last one is read back, while PNG encoding runs on worker threads.
+*/
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define HEADLESS_TARGETS 2
+#define TURNTABLE_SLOTS 4   // frames read back and still being written
+
+typedef struct
+{
+    EGLDisplay dpy;
+    EGLContext ctx;
+    EGLSurface surf;        // EGL_NO_SURFACE on surfaceless contexts
+    GLuint fbo[HEADLESS_TARGETS], target[HEADLESS_TARGETS]; // colour textures frames are drawn into
+    GLuint voxels, hud;
+    uint w, h, targets;
+}
+headless_gl;
+
+static uint eglHasExt(const char* exts, const char* name)
+{
+    if(exts == NULL){return 0;}
+    const size_t len = strlen(name);
+    for(const char* p = strstr(exts, name); p != NULL; p = strstr(p+len, name))
+        if((p == exts || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0x00)){return 1;}
+    return 0;
+}
+
+static void headlessError(const char* what)
+{
+    char tmp[16];
+    timestamp(tmp);
+    printf("[%s] ERROR: %s (EGL 0x%04X, GL 0x%04X)\n", tmp, what, eglGetError(), glGetError());
+}
+
+// context, shader, voxel texture from `g` and 1 or 2 w x h framebuffers
+uint headlessInit(headless_gl* hl, const uint w, const uint h, const uint targets)
+{
+    memset(hl, 0, sizeof(headless_gl));
+    hl->dpy = EGL_NO_DISPLAY;
+    hl->ctx = EGL_NO_CONTEXT;
+    hl->surf = EGL_NO_SURFACE;
+    hl->w = w, hl->h = h;
+    hl->targets = targets < HEADLESS_TARGETS ? targets : HEADLESS_TARGETS;
+
+    // prefer Mesa's surfaceless platform, it never looks for a display server
+    const char* cexts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(eglHasExt(cexts, "EGL_MESA_platform_surfaceless") == 1)
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(getPlatformDisplay != NULL){hl->dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);}
+    }
+    if(hl->dpy == EGL_NO_DISPLAY){hl->dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);}
+    if(hl->dpy == EGL_NO_DISPLAY || eglInitialize(hl->dpy, NULL, NULL) == EGL_FALSE)
+    {
+        headlessError("eglInitialize() failed.");
+        return 0;
+    }
+
+    const EGLint ca[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+                         EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_NONE};
+    EGLConfig cfg;
+    EGLint n = 0;
+    if(eglChooseConfig(hl->dpy, ca, &cfg, 1, &n) == EGL_FALSE || n < 1)
+    {
+        headlessError("no EGL config for OpenGL ES 2.");
+        return 0;
+    }
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint xa[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    hl->ctx = eglCreateContext(hl->dpy, cfg, EGL_NO_CONTEXT, xa);
+    if(hl->ctx == EGL_NO_CONTEXT)
+    {
+        headlessError("eglCreateContext() failed.");
+        return 0;
+    }
+    if(eglHasExt(eglQueryString(hl->dpy, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") == 0)
+    {
+        const EGLint pa[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+        hl->surf = eglCreatePbufferSurface(hl->dpy, cfg, pa);
+        if(hl->surf == EGL_NO_SURFACE)
+        {
+            headlessError("eglCreatePbufferSurface() failed.");
+            return 0;
+        }
+    }
+    if(eglMakeCurrent(hl->dpy, hl->surf, hl->surf, hl->ctx) == EGL_FALSE)
+    {
+        headlessError("eglMakeCurrent() failed.");
+        return 0;
+    }
+
+    GLint maxtex = 0, maxvp[2] = {0};
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxtex);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxvp);
+    if(w > (uint)maxtex || h > (uint)maxtex || w > (uint)maxvp[0] || h > (uint)maxvp[1])
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] ERROR: %ux%u is larger than this driver renders, max %ix%i.\n", tmp, w, h,
+            maxtex < maxvp[0] ? maxtex : maxvp[0], maxtex < maxvp[1] ? maxtex : maxvp[1]);
+        return 0;
+    }
+
+    // same program and quad as the editor
+    makeHud();
+    shadeHud(&position_id, &hud_id, &look_pos_id, &scale_id, &pixel_id, &view_id, &voxel_id);
+    glBindBuffer(GL_ARRAY_BUFFER, mdlPlane.vid);
+    glVertexAttribPointer(position_id, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(position_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mdlPlane.iid);
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+
+    // voxels, and a transparent hud so every pixel is raymarched
+    sVoxel = SDL_RGBA32Surface(1024, 2048);
+    if(sVoxel == NULL){headlessError("out of memory."); return 0;}
+    updateVoxelSurface();
+    hl->voxels = esLoadTextureA(1024, 2048, sVoxel->pixels, 0);
+    const Uint32 clear = 0;
+    hl->hud = esLoadTextureA(1, 1, (const unsigned char*)&clear, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hl->voxels);
+    glUniform1i(voxel_id, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, hl->hud);
+    glUniform1i(hud_id, 1);
+
+    // render targets
+    glActiveTexture(GL_TEXTURE2);
+    glGenTextures(hl->targets, hl->target);
+    glGenFramebuffers(hl->targets, hl->fbo);
+    for(uint i = 0; i < hl->targets; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, hl->target[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindFramebuffer(GL_FRAMEBUFFER, hl->fbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hl->target[i], 0);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            headlessError("framebuffer incomplete.");
+            return 0;
+        }
+    }
+    glViewport(0, 0, w, h);
+    return 1;
+}
+
+// after `g` changed
+void headlessUpload(const headless_gl* hl)
+{
+    updateVoxelSurface();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hl->voxels);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1024, 2048, GL_RGBA, GL_UNSIGNED_BYTE, sVoxel->pixels);
+}
+
+// queue a frame into render target `i`, returns without waiting for it
+void headlessDraw(const headless_gl* hl, const uint i, const render_camera* c)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, hl->fbo[i]);
+    cameraUniforms(c);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawElements(GL_TRIANGLES, hud_numind, GL_UNSIGNED_BYTE, 0);
+    glFlush();
+}
+
+// waits for render target `i`, `rgba` is w*h*4 and bottom up
+void headlessRead(const headless_gl* hl, const uint i, uchar* rgba)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, hl->fbo[i]);
+    glReadPixels(0, 0, hl->w, hl->h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+}
+
+// bottom up rgba to top down rgb
+void headlessFlip(uchar* px, const uchar* rgba, const uint w, const uint h)
+{
+    for(uint y = 0; y < h; y++)
+    {
+        const uchar* s = rgba + (size_t)(h-1-y)*w*4;
+        uchar* d = px + (size_t)y*w*3;
+        for(uint x = 0; x < w; x++, s += 4, d += 3){d[0] = s[0], d[1] = s[1], d[2] = s[2];}
+    }
+}
+
+void headlessFree(headless_gl* hl)
+{
+    if(hl->ctx != EGL_NO_CONTEXT && eglGetCurrentContext() == hl->ctx)
+    {
+        glDeleteFramebuffers(hl->targets, hl->fbo);
+        glDeleteTextures(hl->targets, hl->target);
+        glDeleteTextures(1, &hl->voxels);
+        glDeleteTextures(1, &hl->hud);
+    }
+    if(hl->dpy != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(hl->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(hl->surf != EGL_NO_SURFACE){eglDestroySurface(hl->dpy, hl->surf);}
+        if(hl->ctx != EGL_NO_CONTEXT){eglDestroyContext(hl->dpy, hl->ctx);}
+        eglTerminate(hl->dpy);
+    }
+    SDL_FreeSurface(sVoxel);
+    sVoxel = NULL;
+}
+
+// ./wox render <project> <image.png|image.ppm> <w> <h> <yaw> <elevation> <radius>
+int headlessRender(const char* path, const uint w, const uint h, const render_camera* c)
+{
+    char tmp[16];
+    uchar* px = malloc((size_t)w*h*3);
+    uchar* rgba = malloc((size_t)w*h*4);
+    if(px == NULL || rgba == NULL){free(px); free(rgba); return 1;}
+    headless_gl hl;
+    if(headlessInit(&hl, w, h, 1) == 0)
+    {
+        headlessFree(&hl);
+        free(px);
+        free(rgba);
+        return 1;
+    }
+    timestamp(tmp);
+    printf("[%s] Rendering on %s (%s).\n", tmp, (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+    const uint64_t st = microtime();
+    PROF_BEGIN(PROF_RENDER);
+    headlessDraw(&hl, 0, c);
+    headlessRead(&hl, 0, rgba);
+    headlessFlip(px, rgba, w, h);
+    PROF_END(PROF_RENDER);
+    timestamp(tmp);
+    printf("[%s] Rendered %ux%u. (%'lu μs)\n", tmp, w, h, microtime()-st);
+    headlessFree(&hl);
+    free(rgba);
+    const uint r = writeImage(path, px, w, h);
+    free(px);
+    timestamp(tmp);
+    if(r == 0){printf("[%s] Failed to write: %s\n", tmp, path); return 1;}
+    printf("[%s] Saved render: %s\n", tmp, path);
+    return 0;
+}
+
+typedef struct
+{
+    uchar* rgba;            // read back, bottom up
+    uchar* px;              // flipped rgb for the encoder
+    char path[1024];
+    uint w, h, ok;
+    SDL_Thread* th;
+}
+turntable_slot;
+
+int turntableWrite(void* arg)
+{
+    turntable_slot* s = arg;
+    headlessFlip(s->px, s->rgba, s->w, s->h);
+    s->ok = writeImage(s->path, s->px, s->w, s->h);
+    return 0;
+}
+
+// ./wox turntable <project> <prefix.png|prefix.ppm> <views> <w> <h> <elevation> <radius>
+// writes prefix_00.png, prefix_01.png, ... going once around the model
+int headlessTurntable(const char* prefix, const uint views, const uint w, const uint h, const float elevation, const float radius)
+{
+    char tmp[16];
+    char base[1024], ext[8] = ".png";
+    snprintf(base, sizeof(base), "%s", prefix);
+    const size_t len = strlen(base);
+    if(len > 4 && (strcmp(base+len-4, ".png") == 0 || strcmp(base+len-4, ".ppm") == 0))
+    {
+        sprintf(ext, "%s", base+len-4);
+        base[len-4] = 0x00;
+    }
+    const uint digits = views > 100 ? 3 : 2;
+
+    turntable_slot slot[TURNTABLE_SLOTS];
+    memset(slot, 0, sizeof(slot));
+    uint ok = 1;
+    for(uint i = 0; i < TURNTABLE_SLOTS; i++)
+    {
+        slot[i].rgba = malloc((size_t)w*h*4);
+        slot[i].px = malloc((size_t)w*h*3);
+        slot[i].w = w, slot[i].h = h;
+        if(slot[i].rgba == NULL || slot[i].px == NULL){ok = 0;}
+    }
+    headless_gl hl;
+    memset(&hl, 0, sizeof(hl));
+    if(ok == 1){ok = headlessInit(&hl, w, h, 2);}
+    if(ok == 1)
+    {
+        timestamp(tmp);
+        printf("[%s] Rendering %u views on %s (%s).\n", tmp, views, (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+        const uint64_t st = microtime();
+        PROF_BEGIN(PROF_RENDER);
+
+        // view i+1 is queued before view i is read back, and view i is
+        // encoded and written while the following views render
+        render_camera c;
+        cameraOrbit(&c, 0.f, elevation, radius, w, h);
+        headlessDraw(&hl, 0, &c);
+        for(uint i = 0; i < views; i++)
+        {
+            if(i+1 < views)
+            {
+                cameraOrbit(&c, (float)(i+1) * 360.f / (float)views, elevation, radius, w, h);
+                headlessDraw(&hl, (i+1) % 2, &c);
+            }
+            turntable_slot* s = &slot[i % TURNTABLE_SLOTS];
+            if(s->th != NULL)
+            {
+                SDL_WaitThread(s->th, NULL);
+                s->th = NULL;
+                if(s->ok == 0){ok = 0; printf("[%s] Failed to write: %s\n", tmp, s->path);}
+            }
+            headlessRead(&hl, i % 2, s->rgba);
+            snprintf(s->path, sizeof(s->path), "%s_%0*u%s", base, digits, i, ext);
+            s->th = SDL_CreateThread(turntableWrite, "turntable", s);
+            if(s->th == NULL){turntableWrite(s);}
+        }
+        for(uint i = 0; i < TURNTABLE_SLOTS; i++)
+        {
+            if(slot[i].th == NULL){continue;}
+            SDL_WaitThread(slot[i].th, NULL);
+            slot[i].th = NULL;
+            if(slot[i].ok == 0){ok = 0; printf("[%s] Failed to write: %s\n", tmp, slot[i].path);}
+        }
+
+        PROF_END(PROF_RENDER);
+        const uint64_t us = microtime()-st;
+        timestamp(tmp);
+        printf("[%s] Rendered %u %ux%u views. (%'lu μs, %'lu μs per view)\n", tmp, views, w, h, us, us/views);
+        if(ok == 1){printf("[%s] Saved turntable: %s_%0*u%s ... %s_%0*u%s\n", tmp, base, digits, 0, ext, base, digits, views-1, ext);}
+    }
+    headlessFree(&hl);
+    for(uint i = 0; i < TURNTABLE_SLOTS; i++)
+    {
+        free(slot[i].rgba);
+        free(slot[i].px);
+    }
+    return ok == 1 ? 0 : 1;
+}
+
+#else
+
+int headlessRender(const char* path, const uint w, const uint h, const render_camera* c)
+{
+    printf("ERROR: headless rendering needs EGL, use `./wox preview` for the CPU renderer.\n");
+    return 1;
+}
+int headlessTurntable(const char* prefix, const uint views, const uint w, const uint h, const float elevation, const float radius)
+{
+    printf("ERROR: headless rendering needs EGL.\n");
+    return 1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,390 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Profiler functions.
+
+    Scoped timers around the phases of a frame and the save, load and
+    export paths, kept in a ring buffer and written out as Chrome
+    trace_event JSON that opens in Perfetto or chrome://tracing.
+
+    Recording is off until F9 is pressed or WOX_TRACE=<file.json> is set,
+    while off every timer costs one branch.
+
+    F4 toggles the stats overlay, the same timers then also add up per
+    phase and a handful of counters are turned into per second rates.
+
+    CPU timers around glDrawElements() only see the submission, the GPU
+    timer measures the raymarch itself with EXT_disjoint_timer_query, or
+    with glFinish() on both sides of the draw in debug mode.
+
+    Keyboard and mouse events are timed from when SDL queued them to the
+    submit and swap of the frame that shows them, the overlay and the
+    bench report the distribution.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#define PROF_RING 65536 // events kept, must be a power of two
+
+enum
+{
+    PROF_FRAME,
+    PROF_INPUT,
+    PROF_TRACE,
+    PROF_HUD,
+    PROF_FLIPHUD,
+    PROF_TEXTURE,
+    PROF_DRAW,
+    PROF_SWAP,
+    PROF_SAVE,
+    PROF_LOAD,
+    PROF_EXPORT,
+    PROF_RENDER,
+    PROF_MAX
+};
+const char* prof_names[PROF_MAX] = {"frame", "input", "traceViewPath", "drawHud", "flipHud", "texture_rebuild", "draw", "swap", "saveState", "loadState", "export", "render"};
+
+typedef struct
+{
+    Uint64 ts, dur;         // performance counter ticks
+    SDL_threadID tid;
+    uint phase;
+}
+prof_event;
+
+prof_event* prof_ring = NULL;
+SDL_atomic_t prof_head;
+uint prof_on = 0;
+Uint64 prof_t0 = 0;
+
+// stats overlay
+#define PROF_GRAPH 128 // frame times kept for the graph
+typedef struct
+{
+    Uint64 acc[PROF_MAX];   // ticks spent in each phase
+    Uint64 frames, bytes, rays, steps, edits;
+    Uint64 gpu_ns, gpu_frames;
+}
+prof_counters;
+typedef struct
+{
+    float ms[PROF_MAX];     // ms per frame in each phase
+    float gpu;              // ms per measured draw
+    float fps, bytes, rays, steps, edits; // per second
+}
+prof_rates;
+uint prof_stats = 0;
+prof_counters prof_count = {0};
+prof_rates prof_rate = {0};
+float prof_graph[PROF_GRAPH] = {0};
+uint prof_graph_head = 0;
+
+// input latency, from the time SDL queued a keyboard or mouse event to
+// the submit and the swap of the first frame drawn after it was handled
+#define LAT_PENDING 64    // events timed per frame, the oldest are kept
+#define LAT_SAMPLES 4096  // events kept for the overlay, must be a power of two
+enum{LAT_SUBMIT, LAT_SWAP, LAT_MAX};
+typedef struct
+{
+    float p50, p95, p99, max; // milliseconds
+    uint n;
+}
+lat_stats;
+Uint64 lat_pending[LAT_PENDING];
+uint lat_npending = 0;
+Uint64 lat_submit = 0;
+float lat_ms[LAT_MAX][LAT_SAMPLES];
+uint lat_head = 0;
+lat_stats lat_rate[LAT_MAX] = {0};
+
+// `ts` is the event's SDL_GetTicks() timestamp, the age in ms it spent
+// queued is taken off the performance counter, so it's good to about 1 ms
+void latInput(const Uint32 ts)
+{
+    if(lat_npending == LAT_PENDING){return;}
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const Uint32 age = SDL_GetTicks() - ts;
+    const Uint64 back = age < 1000 ? (Uint64)age * SDL_GetPerformanceFrequency() / 1000 : 0;
+    lat_pending[lat_npending++] = now > back ? now - back : now;
+}
+
+// right after the draw is submitted
+void latSubmit(){if(lat_npending != 0){lat_submit = SDL_GetPerformanceCounter();}}
+
+// right after the swap, returns how many events that frame showed
+uint latSwap()
+{
+    if(lat_npending == 0){return 0;}
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const double ms = 1e3 / (double)SDL_GetPerformanceFrequency();
+    for(uint i = 0; i < lat_npending; i++)
+    {
+        const uint s = lat_head++ & (LAT_SAMPLES-1);
+        lat_ms[LAT_SUBMIT][s] = (float)((double)(lat_submit - lat_pending[i]) * ms);
+        lat_ms[LAT_SWAP][s]   = (float)((double)(now - lat_pending[i]) * ms);
+    }
+    const uint n = lat_npending;
+    lat_npending = 0;
+    return n;
+}
+
+int latCmp(const void* a, const void* b)
+{
+    const float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+void latStats(lat_stats* r, float* v, const uint n)
+{
+    memset(r, 0, sizeof(lat_stats));
+    if(n == 0){return;}
+    qsort(v, n, sizeof(float), latCmp);
+    r->p50 = v[n/2];
+    r->p95 = v[(uint)(n * 0.95f)];
+    r->p99 = v[(uint)(n * 0.99f)];
+    r->max = v[n-1];
+    r->n = n;
+}
+
+void profStart()
+{
+    if(prof_ring == NULL){prof_ring = calloc(PROF_RING, sizeof(prof_event));}
+    if(prof_ring == NULL){return;}
+    if(prof_t0 == 0){prof_t0 = SDL_GetPerformanceCounter();}
+    prof_on = 1;
+}
+void profStop(){prof_on = 0;}
+
+// PROF_BEGIN(PROF_DRAW); ... PROF_END(PROF_DRAW);
+#define PROF_BEGIN(p) const Uint64 prof_##p = (prof_on | prof_stats) ? SDL_GetPerformanceCounter() : 0
+#define PROF_END(p) if(prof_##p != 0){profRecord(p, prof_##p);}
+void profRecord(const uint phase, const Uint64 st)
+{
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if(prof_stats == 1)
+    {
+        prof_count.acc[phase] += now - st;
+        if(phase == PROF_FRAME)
+        {
+            prof_count.frames++;
+            prof_graph[prof_graph_head++ & (PROF_GRAPH-1)] = (float)((double)(now - st) * 1e3 / (double)SDL_GetPerformanceFrequency());
+        }
+    }
+    if(prof_on == 0){return;}
+    prof_event* e = &prof_ring[SDL_AtomicAdd(&prof_head, 1) & (PROF_RING-1)];
+    e->ts = st;
+    e->dur = now - st;
+    e->tid = SDL_ThreadID();
+    e->phase = phase;
+}
+
+// turn the counters into rates, call about once a second
+void profSample()
+{
+    static prof_counters last = {0};
+    static Uint64 lt = 0;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if(lt != 0 && now > lt)
+    {
+        const double sec = (double)(now - lt) / (double)SDL_GetPerformanceFrequency();
+        const Uint64 frames = prof_count.frames - last.frames;
+        const double fms = frames == 0 ? 0.0 : 1e3 / ((double)SDL_GetPerformanceFrequency() * (double)frames);
+        for(uint i = 0; i < PROF_MAX; i++)
+            prof_rate.ms[i] = (float)((double)(prof_count.acc[i] - last.acc[i]) * fms);
+        prof_rate.fps   = (float)((double)frames / sec);
+        prof_rate.bytes = (float)((double)(prof_count.bytes - last.bytes) / sec);
+        prof_rate.rays  = (float)((double)(prof_count.rays  - last.rays)  / sec);
+        prof_rate.steps = (float)((double)(prof_count.steps - last.steps) / sec);
+        prof_rate.edits = (float)((double)(prof_count.edits - last.edits) / sec);
+        const Uint64 gf = prof_count.gpu_frames - last.gpu_frames;
+        prof_rate.gpu = gf == 0 ? 0.f : (float)((double)(prof_count.gpu_ns - last.gpu_ns) * 1e-6 / (double)gf);
+    }
+
+    // latency over the last LAT_SAMPLES events
+    static float v[LAT_SAMPLES];
+    const uint n = lat_head < LAT_SAMPLES ? lat_head : LAT_SAMPLES;
+    for(uint i = 0; i < LAT_MAX; i++)
+    {
+        memcpy(v, lat_ms[i], n*sizeof(float));
+        latStats(&lat_rate[i], v, n);
+    }
+    last = prof_count;
+    lt = now;
+}
+
+// resident set size in bytes, 0 where unknown
+Uint64 profResident()
+{
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(f == NULL){return 0;}
+    unsigned long size = 0, rss = 0;
+    const int r = fscanf(f, "%lu %lu", &size, &rss);
+    fclose(f);
+    if(r != 2){return 0;}
+    return (Uint64)rss * (Uint64)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// write the ring out oldest first as complete ("X") trace events
+uint profDump(const char* file)
+{
+    if(prof_ring == NULL){return 0;}
+    FILE* f = fopen(file, "wb");
+    if(f == NULL){return 0;}
+    const double us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    const uint head = SDL_AtomicGet(&prof_head);
+    const uint n = head < PROF_RING ? head : PROF_RING;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"Woxel\"}}");
+    for(uint i = head - n; i != head; i++)
+    {
+        const prof_event* e = &prof_ring[i & (PROF_RING-1)];
+        if(e->ts < prof_t0){continue;}
+        fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, \"ts\": %.3f, \"dur\": %.3f}",
+            prof_names[e->phase], (unsigned long)e->tid, (double)(e->ts - prof_t0) * us, (double)e->dur * us);
+    }
+    fprintf(f, "\n]}\n");
+    uint r = ferror(f) == 0;
+    r &= fclose(f) == 0;
+    return r;
+}
+
+// WOX_TRACE=<file.json> records from start up and writes the trace on exit
+const char* prof_exit_file = NULL;
+void timestamp(char* ts);
+void profExit()
+{
+    if(profDump(prof_exit_file) == 1)
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] Saved trace: %s\n", tmp, prof_exit_file);
+    }
+}
+void profInit()
+{
+    prof_exit_file = getenv("WOX_TRACE");
+    if(prof_exit_file == NULL || prof_exit_file[0] == 0x00){return;}
+    profStart();
+    atexit(profExit);
+}
+
+//*************************************
+// GPU timer
+//*************************************
+#define GPU_QUERIES 4 // draws in flight before results are read back
+enum{GPU_OFF, GPU_QUERY, GPU_FINISH};
+const char* gpu_names[] = {"off", "EXT_disjoint_timer_query", "glFinish"};
+uint gpu_mode = GPU_OFF;
+GLuint gpu_q[GPU_QUERIES];
+uint gpu_head = 0, gpu_tail = 0;    // queries begun and read back
+Uint64 gpu_t0 = 0;                  // glFinish() mode start
+double gpu_ms = 0.0;                // the latest result
+PFNGLGENQUERIESEXTPROC gpuGenQueries = NULL;
+PFNGLBEGINQUERYEXTPROC gpuBeginQuery = NULL;
+PFNGLENDQUERYEXTPROC gpuEndQuery = NULL;
+PFNGLGETQUERYOBJECTUIVEXTPROC gpuGetQueryObjectuiv = NULL;
+PFNGLGETQUERYOBJECTUI64VEXTPROC gpuGetQueryObjectui64v = NULL;
+
+// WOX_GPUTIME=off|finish overrides the default, which is the timer
+// query when the driver has it, or glFinish() when debugging
+void gpuTimerInit(const uint debug)
+{
+    const char* e = getenv("WOX_GPUTIME");
+    gpu_mode = GPU_OFF;
+    if(e != NULL && strcmp(e, "off") == 0){return;}
+    if(e != NULL && strcmp(e, "finish") == 0){gpu_mode = GPU_FINISH; return;}
+    // Mesa's software rasterizers expose the extension but rasterize at
+    // flush time, outside the query, so their results read close to zero
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const uint software = renderer != NULL && (strstr(renderer, "llvmpipe") != NULL || strstr(renderer, "softpipe") != NULL);
+    if(software == 0 && SDL_GL_ExtensionSupported("GL_EXT_disjoint_timer_query") == SDL_TRUE)
+    {
+        gpuGenQueries = (PFNGLGENQUERIESEXTPROC)SDL_GL_GetProcAddress("glGenQueriesEXT");
+        gpuBeginQuery = (PFNGLBEGINQUERYEXTPROC)SDL_GL_GetProcAddress("glBeginQueryEXT");
+        gpuEndQuery = (PFNGLENDQUERYEXTPROC)SDL_GL_GetProcAddress("glEndQueryEXT");
+        gpuGetQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)SDL_GL_GetProcAddress("glGetQueryObjectuivEXT");
+        gpuGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
+        if(gpuGenQueries != NULL && gpuBeginQuery != NULL && gpuEndQuery != NULL && gpuGetQueryObjectuiv != NULL && gpuGetQueryObjectui64v != NULL)
+        {
+            gpuGenQueries(GPU_QUERIES, gpu_q);
+            gpu_mode = GPU_QUERY;
+            return;
+        }
+    }
+    if(debug == 1){gpu_mode = GPU_FINISH;}
+}
+
+// read back finished queries without waiting, returns how many were read
+uint gpuPoll()
+{
+    if(gpu_mode != GPU_QUERY){return 0;}
+    uint n = 0;
+    GLuint64 ns = 0, sum = 0;
+    while(gpu_tail != gpu_head)
+    {
+        const GLuint q = gpu_q[gpu_tail % GPU_QUERIES];
+        GLuint ready = 0;
+        gpuGetQueryObjectuiv(q, GL_QUERY_RESULT_AVAILABLE_EXT, &ready);
+        if(ready == 0){break;}
+        gpuGetQueryObjectui64v(q, GL_QUERY_RESULT_EXT, &ns);
+        gpu_tail++;
+        sum += ns;
+        n++;
+    }
+
+    // a disjoint event (clock change, context switch) spoils every query
+    // in flight, those just read and those still running are all dropped
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if(disjoint != 0){gpu_tail = gpu_head; return 0;}
+    if(n == 0){return 0;}
+
+    gpu_ms = (double)ns * 1e-6;
+    prof_count.gpu_ns += sum;
+    prof_count.gpu_frames += n;
+    return n;
+}
+
+// gpuBegin(); glDrawElements(...); gpuEnd();
+void gpuBegin()
+{
+    if(gpu_mode == GPU_QUERY)
+    {
+        gpuPoll();
+        if(gpu_head - gpu_tail >= GPU_QUERIES){return;} // all busy, skip this draw
+        gpuBeginQuery(GL_TIME_ELAPSED_EXT, gpu_q[gpu_head % GPU_QUERIES]);
+        gpu_t0 = 1;
+    }
+    else if(gpu_mode == GPU_FINISH)
+    {
+        glFinish();
+        gpu_t0 = SDL_GetPerformanceCounter();
+    }
+}
+void gpuEnd()
+{
+    if(gpu_t0 == 0){return;}
+    if(gpu_mode == GPU_QUERY)
+    {
+        gpuEndQuery(GL_TIME_ELAPSED_EXT);
+        gpu_head++;
+    }
+    else if(gpu_mode == GPU_FINISH)
+    {
+        glFinish();
+        const Uint64 ns = (Uint64)((double)(SDL_GetPerformanceCounter() - gpu_t0) * 1e9 / (double)SDL_GetPerformanceFrequency());
+        gpu_ms = (double)ns * 1e-6;
+        prof_count.gpu_ns += ns;
+        prof_count.gpu_frames++;
+    }
+    gpu_t0 = 0;
+}
+
+#endif
@@ -0,0 +1,411 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Region functions.
+
+    Two corner picks make a box that can then be filled, cleared,
+    repainted or have one color replaced inside it. Every operation
+    works a row of x at a time over the PTI() layout, which is a run of
+    contiguous bytes, and goes through the edit API so the renderer
+    uploads only the texture rectangles the box covers.
+
+    The flood fill walks the same x rows as spans.
+*/
+
+#ifndef REGION_H
+#define REGION_H
+
+enum{REGION_FILL, REGION_CLEAR, REGION_REPAINT, REGION_REPLACE, REGION_OPS};
+const char* region_names[REGION_OPS] = {"Filled", "Cleared", "Repainted", "Replaced"};
+
+region_box region = {0};
+uint region_corners = 0; // 0 none, 1 first corner picked, 2 box ready
+
+// the first pick starts a box, the second completes it, a third starts over
+void regionCorner(const uchar x, const uchar y, const uchar z)
+{
+    if(region_corners != 1)
+    {
+        region = (region_box){x, y, z, x, y, z};
+        region_corners = 1;
+        return;
+    }
+    if(x < region.x0){region.x0 = x;}else{region.x1 = x;}
+    if(y < region.y0){region.y0 = y;}else{region.y1 = y;}
+    if(z < region.z0){region.z0 = z;}else{region.z1 = z;}
+    region_corners = 2;
+}
+
+// the box reflected in the symmetry planes of `m`, clipped to the volume,
+// returns 0 when none of it is left
+uint regionReflect(const region_box* b, const uint m, region_box* o)
+{
+    const int lo[3] = {b->x0, b->y0, b->z0}, hi[3] = {b->x1, b->y1, b->z1};
+    int l[3], h[3];
+    for(uint a = 0; a < 3; a++)
+    {
+        l[a] = m & (1 << a) ? sym_c2[a]-hi[a] : lo[a];
+        h[a] = m & (1 << a) ? sym_c2[a]-lo[a] : hi[a];
+        if(l[a] < 0){l[a] = 0;}
+        if(h[a] > 127){h[a] = 127;}
+        if(l[a] > h[a]){return 0;}
+    }
+    *o = (region_box){l[0], l[1], l[2], h[0], h[1], h[2]};
+    return 1;
+}
+
+// apply `op` to every voxel in the box, `color` is what is written and
+// `from` the color REGION_REPLACE looks for, returns the voxels changed
+uint regionApply(game_state* s, const region_box* b, const uint op, const uchar color, const uchar from)
+{
+    const uint w = b->x1 - b->x0 + 1;
+    const uchar v = op == REGION_CLEAR ? 0 : color;
+    if(op == REGION_FILL || op == REGION_CLEAR){return editBox(s, b->x0, b->y0, b->z0, b->x1, b->y1, b->z1, v);}
+    uint n = 0;
+    for(uint z = b->z0; z <= b->z1; z++)
+    {
+        for(uint y = b->y0; y <= b->y1; y++)
+        {
+            const uint i = PTI(b->x0, y, z);
+            if(op == REGION_REPAINT){n += editPaint(s, i, w, v);}
+            else if(op == REGION_REPLACE){n += editReplace(s, i, w, from, v);}
+        }
+    }
+    return n;
+}
+
+//*************************************
+// flood fill
+//*************************************
+enum{FLOOD_COLOR, FLOOD_SOLID};
+#define FLOOD_SURFACE 2      // or'd with the above, only paint exposed voxels
+#define FLOOD_STACK 1048576  // the most x runs the volume can hold, 128*128/2 per z
+uint* flood_stack = NULL;    // packed runs, start index | end x << 21
+uchar* flood_seen = NULL;
+
+static inline uint floodMatch(const uchar c, const uint solid, const uchar from)
+{
+    return solid == 1 ? c != 0 : c == from;
+}
+
+// a face on an empty voxel or the edge of the volume
+static inline uint floodExposed(const uchar* v, const uint i)
+{
+    const uint x = i & 127, y = (i >> 7) & 127, z = i >> 14;
+    if(x == 0 || y == 0 || z == 0 || x == 127 || y == 127 || z == 127){return 1;}
+    return v[i-1] == 0 || v[i+1] == 0 || v[i-128] == 0 || v[i+128] == 0 || v[i-16384] == 0 || v[i+16384] == 0;
+}
+
+// push every unseen matching run in row (y,z) that touches x0 to x1, a
+// run is marked seen as it's pushed so each is pushed once at most
+static inline uint floodRow(const uchar* v, const uint r, const uint x0, const uint x1, const uint solid, const uchar from, uint sp)
+{
+    const uchar* row = v + r;
+    uchar* seen = flood_seen + r;
+    for(uint x = x0; x <= x1; x++)
+    {
+        // most of a row is already seen in a big fill, skip it as a block
+        const uchar* u = memchr(seen + x, 0, x1-x+1);
+        if(u == NULL){break;}
+        x = u - seen;
+        if(floodMatch(row[x], solid, from) == 0){continue;}
+        uint a = x, b = x;
+        while(a > 0 && floodMatch(row[a-1], solid, from) == 1){a--;}
+        while(b < 127 && floodMatch(row[b+1], solid, from) == 1){b++;}
+        memset(seen + a, 1, b-a+1);
+        flood_stack[sp++] = (r + a) | (b << 21);
+        x = b;
+    }
+    return sp;
+}
+
+// paint the 6-connected voxels reached from (x,y,z) with `color`, joined
+// by the seed's color or FLOOD_SOLID by any filled voxel, returns the
+// voxels changed. Scanline spans on an explicit preallocated stack, no
+// recursion, so a whole 2M voxel component is a few milliseconds.
+uint floodFill(game_state* s, const uchar x, const uchar y, const uchar z, const uchar color, const uint mode)
+{
+    if(flood_stack == NULL){flood_stack = malloc(FLOOD_STACK*sizeof(uint));}
+    if(flood_seen == NULL){flood_seen = malloc(max_voxels);}
+    if(flood_stack == NULL || flood_seen == NULL){return 0;}
+    const uint solid = mode & 1, surface = (mode & FLOOD_SURFACE) != 0;
+    uchar* v = s->voxels;
+    const uchar from = v[PTI(x, y, z)];
+    if(from == 0 || (solid == 0 && from == color)){return 0;}
+    memset(flood_seen, 0, max_voxels);
+
+    uint sp = floodRow(v, PTI(0, y, z), x, x, solid, from, 0);
+    uint n = 0;
+    while(sp > 0)
+    {
+        const uint e = flood_stack[--sp];
+        const uint i0 = e & 0x1FFFFF, x0 = i0 & 127, x1 = e >> 21;
+        const uint r = i0 - x0, ry = (i0 >> 7) & 127, rz = i0 >> 14;
+        const uint i1 = r + x1;
+
+        // the neighbours first, surface mode reads them and painting
+        // never empties a voxel so the order doesn't change the result
+        if(ry > 0)  {sp = floodRow(v, r-128,   x0, x1, solid, from, sp);}
+        if(ry < 127){sp = floodRow(v, r+128,   x0, x1, solid, from, sp);}
+        if(rz > 0)  {sp = floodRow(v, r-16384, x0, x1, solid, from, sp);}
+        if(rz < 127){sp = floodRow(v, r+16384, x0, x1, solid, from, sp);}
+
+        if(surface == 0){n += editSpan(s, i0, x1-x0+1, color); continue;}
+        for(uint i = i0; i <= i1; i++)
+            if(floodExposed(v, i) == 1){n += editVoxel(s, i, color);}
+    }
+    return n;
+}
+
+//*************************************
+// clipboard
+//*************************************
+typedef struct
+{
+    uchar x, y, z, n; // n voxels along x from (x,y,z) in clip space
+}
+clip_run;
+
+clip_run* clip_runs = NULL;
+uchar* clip_colors = NULL;   // the runs' voxels back to back
+uint clip_nruns = 0, clip_voxels = 0;
+uint clip_w = 0, clip_h = 0, clip_d = 0; // 0 is empty
+uint clip_rot = 0, clip_flip = 0;        // quarter turns about z, x mirrored first
+
+// keep the filled voxels of the box as runs, returns the voxels copied
+uint clipCopy(const game_state* s, const region_box* b)
+{
+    // count first so the clipboard is allocated to size
+    uint nr = 0, nv = 0;
+    for(uint z = b->z0; z <= b->z1; z++)
+    {
+        for(uint y = b->y0; y <= b->y1; y++)
+        {
+            const uchar* row = &s->voxels[PTI(0, y, z)];
+            for(uint x = b->x0; x <= b->x1; x++)
+            {
+                if(row[x] == 0){continue;}
+                nr += x == b->x0 || row[x-1] == 0;
+                nv++;
+            }
+        }
+    }
+    clip_run* r = malloc(nr*sizeof(clip_run) + 1);
+    uchar* c = malloc(nv + 1);
+    if(r == NULL || c == NULL){free(r); free(c); return 0;}
+    free(clip_runs);
+    free(clip_colors);
+    clip_runs = r, clip_colors = c, clip_nruns = nr, clip_voxels = nv;
+    clip_w = b->x1-b->x0+1, clip_h = b->y1-b->y0+1, clip_d = b->z1-b->z0+1;
+
+    for(uint z = b->z0; z <= b->z1; z++)
+    {
+        for(uint y = b->y0; y <= b->y1; y++)
+        {
+            const uchar* row = &s->voxels[PTI(0, y, z)];
+            for(uint x = b->x0; x <= b->x1; x++)
+            {
+                if(row[x] == 0){continue;}
+                uint e = x;
+                while(e < b->x1 && row[e+1] != 0){e++;}
+                *r++ = (clip_run){x-b->x0, y-b->y0, z-b->z0, e-x+1};
+                memcpy(c, row+x, e-x+1);
+                c += e-x+1;
+                x = e;
+            }
+        }
+    }
+    return nv;
+}
+
+// the pasted size along x and y after rotation
+static inline uint clipWidth(const uint rot){return (rot & 1) == 0 ? clip_w : clip_h;}
+static inline uint clipHeight(const uint rot){return (rot & 1) == 0 ? clip_h : clip_w;}
+
+// write the filled voxels with the clip's min corner at (ox,oy,oz), empty
+// clip voxels leave what's there, anything outside the volume is dropped,
+// returns the voxels changed
+// where run `cr` starts once turned and flipped, and the step along it
+static inline void clipPlace(const clip_run* cr, const uint rot, const uint flip, int* x, int* y, int* dx, int* dy)
+{
+    const int w = clip_w, h = clip_h;
+    const int sx = flip == 1 ? -1 : 1;
+    const int fx = flip == 1 ? w-1-cr->x : cr->x;
+    const uint r4 = rot & 3;
+    if(     r4 == 0){*x = fx,        *y = cr->y,      *dx = sx, *dy = 0;}
+    else if(r4 == 1){*x = h-1-cr->y, *y = fx,         *dx = 0,  *dy = sx;}
+    else if(r4 == 2){*x = w-1-fx,    *y = h-1-cr->y,  *dx = -sx, *dy = 0;}
+    else            {*x = cr->y,     *y = w-1-fx,     *dx = 0,  *dy = -sx;}
+}
+uint clipPaste(game_state* s, const int ox, const int oy, const int oz, const uint rot, const uint flip)
+{
+    const uint r4 = rot & 3;
+    uint n = 0;
+    const uchar* c = clip_colors;
+    for(uint i = 0; i < clip_nruns; c += clip_runs[i++].n)
+    {
+        const clip_run* cr = &clip_runs[i];
+        int x, y, dx, dy;
+        clipPlace(cr, rot, flip, &x, &y, &dx, &dy);
+        x += ox, y += oy;
+        const int z = oz + cr->z;
+        if(z < 0 || z > 127){continue;}
+
+        // unrotated and unflipped a run is still a row, copy it whole
+        if(r4 == 0 && flip == 0 && y >= 0 && y <= 127 && x >= 0 && x+cr->n <= 128)
+        {
+            n += editCopy(s, PTI(x, y, z), c, cr->n);
+            continue;
+        }
+        for(uint k = 0; k < cr->n; k++, x += dx, y += dy)
+            if(x >= 0 && y >= 0 && x <= 127 && y <= 127){n += editVoxel(s, PTI(x, y, z), c[k]);}
+    }
+    return n;
+}
+// the symmetry images of a clipPaste() with the same arguments, each
+// pasted voxel goes wherever symPoints() sends it so every mirror plane
+// reflects the paste and the radial copies turn it, like they do a brush
+uint clipMirror(game_state* s, const int ox, const int oy, const int oz, const uint rot, const uint flip)
+{
+    static int p[SYM_MAX][3];
+    uint n = 0;
+    const uchar* c = clip_colors;
+    for(uint i = 0; i < clip_nruns; c += clip_runs[i++].n)
+    {
+        const clip_run* cr = &clip_runs[i];
+        int x, y, dx, dy;
+        clipPlace(cr, rot, flip, &x, &y, &dx, &dy);
+        x += ox, y += oy;
+        const int z = oz + cr->z;
+        for(uint k = 0; k < cr->n; k++, x += dx, y += dy)
+        {
+            const uint np = symPoints(x, y, z, p);
+            for(uint j = 1; j < np; j++) // 0 is the paste itself
+            {
+                const int* q = p[j];
+                if(q[0] < 0 || q[1] < 0 || q[2] < 0 || q[0] > 127 || q[1] > 127 || q[2] > 127){continue;}
+                n += editVoxel(s, PTI(q[0], q[1], q[2]), c[k]);
+            }
+        }
+    }
+    return n;
+}
+
+//*************************************
+// editor
+//*************************************
+
+// where a left click would place, or the pointed voxel, or with nothing
+// pointed at the spot V places at
+vec regionPoint()
+{
+    traceViewPath(1);
+    vec p;
+    if(g.pb.w == 1.f && isInBounds(g.pb) == 1){p = g.pb;}
+    else if(lray > -1){p = ghp;}
+    else
+    {
+        p = g.pp;
+        vInv(&p);
+        vec pi = look_dir;
+        vMulS(&pi, pi, 6.f);
+        vAdd(&p, p, pi);
+    }
+    return (vec){roundf(p.x), roundf(p.y), roundf(p.z), 1.f};
+}
+
+// B picks a corner at regionPoint()
+void regionPick()
+{
+    const vec p = regionPoint();
+    if(isInBounds(p) == 0){sprintf(warnm, "Box corner out of bounds."); wti = t+1.f; return;}
+    regionCorner(p.x, p.y, p.z);
+}
+
+// G, H, J, K on a finished box, and its reflections in the mirror planes
+void regionEdit(const uint op)
+{
+    if(region_corners != 2){sprintf(warnm, "Pick two box corners with B first."); wti = t+1.f; return;}
+    uchar from = 0;
+    if(op == REGION_REPLACE)
+    {
+        traceViewPath(0);
+        if(lray < 0){sprintf(warnm, "Point at a voxel of the color to replace."); wti = t+1.f; return;}
+        from = g.voxels[lray];
+    }
+    uint n = regionApply(&g, &region, op, g.st, from);
+    for(uint m = 1; m < 8; m++) // the mirror planes, boxes don't turn radially
+    {
+        region_box b;
+        if((m & sym_axes) == m && regionReflect(&region, m, &b) == 1){n += regionApply(&g, &b, op, g.st, from);}
+    }
+    prof_count.edits += n;
+    sprintf(warnm, "%s %u voxels.", region_names[op], n);
+    wti = t+1.f;
+}
+
+// T fills from the pointed voxel and its symmetry images, Y steps through the modes
+uint flood_mode = FLOOD_COLOR;
+const char* flood_names[4] = {"Flood fill same color.", "Flood fill any filled.", "Flood fill same color surface.", "Flood fill any filled surface."};
+void floodEdit()
+{
+    traceViewPath(0);
+    if(lray < 0){sprintf(warnm, "Point at a voxel to flood fill from."); wti = t+1.f; return;}
+    int p[SYM_MAX][3];
+    const uint np = symPoints(ghp.x, ghp.y, ghp.z, p);
+    uint n = 0;
+    for(uint i = 0; i < np; i++)
+    {
+        if(p[i][0] < 0 || p[i][1] < 0 || p[i][2] < 0 || p[i][0] > 127 || p[i][1] > 127 || p[i][2] > 127){continue;}
+        n += floodFill(&g, p[i][0], p[i][1], p[i][2], g.st, flood_mode);
+    }
+    prof_count.edits += n;
+    sprintf(warnm, "Flood filled %u voxels.", n);
+    wti = t+1.f;
+}
+void floodMode()
+{
+    flood_mode = (flood_mode + 1) & 3;
+    sprintf(warnm, "%s", flood_names[flood_mode]);
+    wti = t+1.f;
+}
+
+// N copies the box, M stamps it with its base centred on regionPoint(),
+// held it stamps again each time that point moves. Comma turns the
+// clipboard and period mirrors it.
+float ctt = 0.f;            // paste timing trigger (for repeat stamping)
+vec clip_last = {0.f, 0.f, 0.f, -1.f};
+void clipEdit()
+{
+    if(region_corners != 2){sprintf(warnm, "Pick two box corners with B first."); wti = t+1.f; return;}
+    const uint n = clipCopy(&g, &region);
+    clip_rot = 0, clip_flip = 0;
+    sprintf(warnm, "Copied %u voxels %ux%ux%u.", n, clip_w, clip_h, clip_d);
+    wti = t+1.f;
+}
+void clipStamp(const uint held)
+{
+    if(clip_w == 0){if(held == 0){sprintf(warnm, "Copy a box with N first."); wti = t+1.f;} return;}
+    const vec p = regionPoint();
+    if(held == 1 && p.x == clip_last.x && p.y == clip_last.y && p.z == clip_last.z){return;}
+    clip_last = p;
+    const int w = clipWidth(clip_rot), h = clipHeight(clip_rot);
+    const int ox = (int)p.x - w/2, oy = (int)p.y - h/2, oz = p.z;
+    uint n = clipPaste(&g, ox, oy, oz, clip_rot, clip_flip);
+    if(symOn() == 1){n += clipMirror(&g, ox, oy, oz, clip_rot, clip_flip);}
+    prof_count.edits += n;
+    sprintf(warnm, "Pasted %u voxels.", n);
+    wti = t+1.f;
+}
+void clipTurn(const uint flip)
+{
+    if(flip == 1){clip_flip = 1-clip_flip;}
+    else{clip_rot = (clip_rot+1) & 3;}
+    sprintf(warnm, "Clipboard turned %u degrees%s.", clip_rot*90, clip_flip == 1 ? " and mirrored" : "");
+    wti = t+1.f;
+}
+
+#endif
@@ -0,0 +1,255 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Render regression functions.
+
+    `./wox regress <golden_dir>` renders the synthetic microbench volumes,
+    and any projects given, from a fixed set of cameras through the
+    headless shader and compares each image against a stored golden with
+    a per channel tolerance. Failures leave `<name>.new.png` and a
+    `<name>.diff.png` next to the golden. A missing or unreadable golden
+    fails too, -u writes them all after an intended change to the picture.
+    The goldens for the micro volumes are kept in regress/, `make regress`
+    checks against them. Every view is also drawn by the CPU renderer and
+    compared with the GPU image, `<name>_cpu` in the output.
+*/
+
+#ifndef REGRESS_H
+#define REGRESS_H
+
+#define REGRESS_WIDTH 256
+#define REGRESS_HEIGHT 192
+#define REGRESS_TOLERANCE 2 // per channel, llvmpipe against itself is exact
+#define REGRESS_CAMERAS 6
+#define REGRESS_CPU_TOLERANCE 1 // per channel, CPU render against the GPU one, the driver's color rounding
+#define REGRESS_CPU_PIXELS 0    // every ray has to pick the same voxel
+
+typedef struct
+{
+    const char* name;
+    float yaw, elevation, radius;
+}
+regress_camera;
+
+// outside on the faces and corners, from above, right up close, from inside
+// the volume and skimming the edge, the paths the shader treats differently
+const regress_camera regress_cameras[REGRESS_CAMERAS] = {
+    {"front",   0.f,   0.f,   200.f},
+    {"corner",  45.f,  35.26f, 220.f},
+    {"top",     30.f,  80.f,  200.f},
+    {"close",   200.f, 15.f,  70.f},
+    {"inside",  120.f, 10.f,  20.f},
+    {"grazing", 90.f,  0.5f,  300.f},
+};
+
+#ifdef __linux__
+
+typedef struct
+{
+    uint tolerance, max_pixels, update;
+    uint passed, failed, written;
+}
+regress_job;
+
+// pass or fail `px` against the reference `ref`, both rgb REGRESS_WIDTH x
+// REGRESS_HEIGHT. A pixel fails when a channel is more than `tolerance`
+// off and the case when more than `max_pixels` fail, then `px` is kept as
+// <name>.new.png with <name>.diff.png, the reference dimmed to a third and
+// the failing pixels in red.
+void regressCompare(regress_job* j, const char* dir, const char* name, const uchar* px, const uchar* ref, const uint tolerance, const uint max_pixels)
+{
+    char tmp[16];
+    const uint n = REGRESS_WIDTH*REGRESS_HEIGHT;
+    uchar* diff = malloc(n*3);
+    if(diff == NULL){j->failed++; return;}
+    uint bad = 0, worst = 0;
+    for(uint i = 0; i < n; i++)
+    {
+        const uchar* a = px + i*3;
+        const uchar* b = ref + i*3;
+        uint m = 0;
+        for(uint c = 0; c < 3; c++)
+        {
+            const uint d = a[c] > b[c] ? a[c]-b[c] : b[c]-a[c];
+            if(d > m){m = d;}
+        }
+        if(m > worst){worst = m;}
+        uchar* o = diff + i*3;
+        if(m > tolerance)
+        {
+            bad++;
+            o[0] = 128 + (m >> 1), o[1] = 0, o[2] = 0;
+        }
+        else{o[0] = b[0] / 3, o[1] = b[1] / 3, o[2] = b[2] / 3;}
+    }
+
+    timestamp(tmp);
+    if(bad <= max_pixels)
+    {
+        printf("[%s] pass %s (max delta %u, %u pixels over %u)\n", tmp, name, worst, bad, tolerance);
+        j->passed++;
+        free(diff);
+        return;
+    }
+    printf("[%s] FAIL %s: %u pixels over tolerance %u, %u allowed, max delta %u\n", tmp, name, bad, tolerance, max_pixels, worst);
+    j->failed++;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.new.png", dir, name);
+    writeImage(path, px, REGRESS_WIDTH, REGRESS_HEIGHT);
+    snprintf(path, sizeof(path), "%s/%s.diff.png", dir, name);
+    writeImage(path, diff, REGRESS_WIDTH, REGRESS_HEIGHT);
+    free(diff);
+}
+
+// compare one render against its golden, `px` is rgb REGRESS_WIDTH x REGRESS_HEIGHT
+void regressCheck(regress_job* j, const char* dir, const char* name, const uchar* px)
+{
+    char tmp[16];
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.png", dir, name);
+    if(j->update == 1)
+    {
+        timestamp(tmp);
+        if(writeImage(path, px, REGRESS_WIDTH, REGRESS_HEIGHT) == 0)
+        {
+            printf("[%s] FAIL %s: could not write %s\n", tmp, name, path);
+            j->failed++;
+            return;
+        }
+        printf("[%s] Updated %s\n", tmp, path);
+        j->written++;
+        return;
+    }
+
+    // a missing or damaged golden fails, only -u writes goldens
+    uint gw = 0, gh = 0;
+    uchar* gold = readImage(path, &gw, &gh);
+    if(gold == NULL)
+    {
+        FILE* f = fopen(path, "rb");
+        if(f != NULL){fclose(f);}
+        timestamp(tmp);
+        printf("[%s] FAIL %s: %s %s, run with -u to write it\n", tmp, name, path, f == NULL ? "is missing" : "could not be read");
+        j->failed++;
+        snprintf(path, sizeof(path), "%s/%s.new.png", dir, name);
+        writeImage(path, px, REGRESS_WIDTH, REGRESS_HEIGHT);
+        return;
+    }
+
+    if(gw != REGRESS_WIDTH || gh != REGRESS_HEIGHT)
+    {
+        free(gold);
+        timestamp(tmp);
+        printf("[%s] FAIL %s: golden is %ux%u, expected %ux%u\n", tmp, name, gw, gh, REGRESS_WIDTH, REGRESS_HEIGHT);
+        j->failed++;
+        return;
+    }
+    regressCompare(j, dir, name, px, gold, j->tolerance, j->max_pixels);
+    free(gold);
+}
+
+// every camera on the volume currently in `g`
+void regressVolume(regress_job* j, const headless_gl* hl, const char* dir, const char* volume, uchar* px, uchar* cpu, uchar* rgba)
+{
+    headlessUpload(hl);
+    for(uint i = 0; i < REGRESS_CAMERAS; i++)
+    {
+        const regress_camera* rc = &regress_cameras[i];
+        render_camera c;
+        cameraOrbit(&c, rc->yaw, rc->elevation, rc->radius, REGRESS_WIDTH, REGRESS_HEIGHT);
+        headlessDraw(hl, 0, &c);
+        headlessRead(hl, 0, rgba);
+        headlessFlip(px, rgba, REGRESS_WIDTH, REGRESS_HEIGHT);
+        char name[512];
+        snprintf(name, sizeof(name), "%s_%s", volume, rc->name);
+        regressCheck(j, dir, name, px);
+
+        // the CPU reference renderer has to draw the same picture
+        renderImage(cpu, &g, &c, REGRESS_WIDTH, REGRESS_HEIGHT, 0);
+        snprintf(name, sizeof(name), "%s_%s_cpu", volume, rc->name);
+        regressCompare(j, dir, name, cpu, px, REGRESS_CPU_TOLERANCE, REGRESS_CPU_PIXELS);
+    }
+}
+
+// ./wox regress [-u] [-t<tolerance>] [-p<pixels>] <golden_dir> <[OPTIONAL]project|file.wox.gz> ...
+int regressRun(int argc, char** argv)
+{
+    regress_job j = {REGRESS_TOLERANCE, 0, 0, 0, 0, 0};
+    int a = 2;
+    for(NULL; a < argc && argv[a][0] == '-'; a++)
+    {
+        if(     strcmp(argv[a], "-u") == 0){j.update = 1;}
+        else if(strncmp(argv[a], "-t", 2) == 0){j.tolerance = atoi(argv[a]+2);}
+        else if(strncmp(argv[a], "-p", 2) == 0){j.max_pixels = atoi(argv[a]+2);}
+        else{printf("ERROR: unknown regress option \"%s\".\n", argv[a]); return 1;}
+    }
+    if(a >= argc){printf("ERROR: regress needs a golden image directory.\n"); return 1;}
+    const char* dir = argv[a++];
+    mkdir(dir, 0755);
+
+    uchar* px = malloc(REGRESS_WIDTH*REGRESS_HEIGHT*3);
+    uchar* cpu = malloc(REGRESS_WIDTH*REGRESS_HEIGHT*3);
+    uchar* rgba = malloc(REGRESS_WIDTH*REGRESS_HEIGHT*4);
+    if(px == NULL || cpu == NULL || rgba == NULL){free(px); free(cpu); free(rgba); return 1;}
+    microVolume(&g, 0);
+    headless_gl hl;
+    if(headlessInit(&hl, REGRESS_WIDTH, REGRESS_HEIGHT, 1) == 0)
+    {
+        headlessFree(&hl);
+        free(px);
+        free(cpu);
+        free(rgba);
+        return 1;
+    }
+    char tmp[16];
+    timestamp(tmp);
+    printf("[%s] Regression rendering on %s (%s), tolerance %u, %u pixels allowed.\n", tmp,
+        (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION), j.tolerance, j.max_pixels);
+
+    for(uint v = 0; v < MICRO_VOLUMES; v++)
+    {
+        char name[32];
+        snprintf(name, 32, "micro_%s", micro_volumes[v]);
+        microVolume(&g, v);
+        regressVolume(&j, &hl, dir, name, px, cpu, rgba);
+    }
+    for(NULL; a < argc; a++)
+    {
+        const char* in = argv[a];
+        char file[1024];
+        projectFile(file, 1024, in);
+        if(readState(&g, file) == 0)
+        {
+            timestamp(tmp);
+            printf("[%s] FAIL %s: could not load %s\n", tmp, in, file);
+            j.failed++;
+            continue;
+        }
+        char name[256];
+        projectName(name, 256, in);
+        regressVolume(&j, &hl, dir, name, px, cpu, rgba);
+    }
+
+    headlessFree(&hl);
+    free(px);
+    free(cpu);
+    free(rgba);
+    timestamp(tmp);
+    printf("[%s] %u passed, %u failed, %u golden images written.\n", tmp, j.passed, j.failed, j.written);
+    return j.failed > 0;
+}
+
+#else
+
+int regressRun(int argc, char** argv)
+{
+    printf("ERROR: regress renders headless and needs EGL.\n");
+    return 1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,389 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Render functions.
+
+    A CPU port of the `ray()` traversal in the f0 shader, so previews and
+    thumbnails can be made on machines without a GPU. The arithmetic is
+    kept in the same order as the GLSL, rays included, f0 builds its ray
+    from gl_FragCoord instead of an interpolated varying so both sides do
+    the same float sums. Every ray picks the same voxel, only the driver's
+    color rounding can be 1/255 off. Don't build it with fast math if it
+    has to match exactly. If you change one then change the other.
+*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+//*************************************
+// camera
+//*************************************
+typedef struct
+{
+    vec pos;                // look_pos uniform, the eye in voxel space
+    vec right, up, forward; // view[3] uniform
+    float xscale, yscale;   // scale uniform, aspect correction
+    float xpixel, ypixel;   // pixel uniform, 1/width and 1/height
+}
+render_camera;
+
+// same as the view setup at the top of main_loop() and WOX_POP()
+void cameraAim(render_camera* c, const vec pos, const float xrot, const float yrot, const uint w, const uint h)
+{
+    mat v;
+    mIdent(&v);
+    mRotate(&v, yrot, 1.f, 0.f, 0.f);
+    mRotate(&v, xrot, 0.f, 0.f, 1.f);
+    mGetViewX(&c->right, v);
+    vInv(&c->right);
+    mGetViewY(&c->up, v);
+    vInv(&c->up);
+    mGetViewZ(&c->forward, v);
+    c->pos = pos;
+    if(w < h){c->xscale = (float)w/(float)h, c->yscale = 1.f;}
+    else{c->xscale = 1.f, c->yscale = (float)h/(float)w;}
+    c->xpixel = 1.f/(float)w, c->ypixel = 1.f/(float)h;
+}
+
+// the camera saved with the project
+void cameraState(render_camera* c, const game_state* s, const uint w, const uint h)
+{
+    cameraAim(c, (vec){-s->pp.x, -s->pp.y, -s->pp.z}, s->xrot, s->yrot, w, h);
+}
+
+// looking at the middle of the volume from `radius` voxels away,
+// yaw spins around the z axis and elevation is in degrees above the horizon
+void cameraOrbit(render_camera* c, const float yaw, const float elevation, const float radius, const uint w, const uint h)
+{
+    cameraAim(c, (vec){0.f, 0.f, 0.f}, yaw*DEG2RAD, (90.f-elevation)*DEG2RAD, w, h);
+    c->pos.x = 63.5f - c->forward.x*radius;
+    c->pos.y = 63.5f - c->forward.y*radius;
+    c->pos.z = 63.5f - c->forward.z*radius;
+}
+
+// hand the camera to the f0 shader, what main_loop() does with `g`
+void cameraUniforms(const render_camera* c)
+{
+    glUniform3f(look_pos_id, c->pos.x, c->pos.y, c->pos.z);
+    glUniform3fv(view_id + 0, 1, (GLfloat*)&c->right);
+    glUniform3fv(view_id + 1, 1, (GLfloat*)&c->up);
+    glUniform3fv(view_id + 2, 1, (GLfloat*)&c->forward);
+    glUniform2f(scale_id, c->xscale, c->yscale);
+    glUniform2f(pixel_id, c->xpixel, c->ypixel);
+}
+
+//*************************************
+// raymarcher
+//*************************************
+#define RENDER_TILE 32
+#define RENDER_PACKET 8 // rays set up together, see renderWorker()
+
+typedef struct
+{
+    const uchar* voxels;
+    uchar rgb[256][3];      // voxel value to texel color, like the sVoxel texture
+    uchar lit[3][256];      // texel byte times the per axis multiplier
+    uchar solid[256];       // texel alpha != 0
+    render_camera cam;
+    uchar* px;              // w*h*3 rgb
+    uint w, h, tw, th;
+    SDL_atomic_t next;      // next tile to be claimed by a worker
+}
+render_job;
+
+// voxel_at() in f0, including how the 128^3 volume folds into the
+// 1024x2048 texture and the clamp to edge sampling past its borders
+static inline uchar renderVoxel(const uchar* voxels, const float x, const float y, const float z)
+{
+    const int ix = (int)floorf(x + 0.5f);
+    const int iy = (int)floorf(y + 0.5f);
+    const int iz = (int)floorf(z + 0.5f);
+    const int yh = (int)floorf((float)iy / 16.f);
+    int col = (iz * 8) + yh;
+    int row = ((iy - (yh * 16)) * 128) + ix;
+    if(col < 0){col = 0;}else if(col > 1023){col = 1023;}
+    if(row < 0){row = 0;}else if(row > 2047){row = 2047;}
+    return voxels[(col * 2048) + row];
+}
+
+static inline uchar renderUnit(const float f)
+{
+    if(f <= 0.f){return 0;}
+    if(f >= 1.f){return 255;}
+    return (uchar)(f * 255.f + 0.5f);
+}
+
+static inline void renderFog(uchar* o, const float sx, const float sy, const vec look, const vec pos)
+{
+    const float dx = look.x-pos.x, dy = look.y-pos.y, dz = look.z-pos.z;
+    float f = 1.f-(sqrtf(dx*dx + dy*dy + dz*dz) * 0.002590674f);
+    if(f < 0.6f){f = 0.6f;}
+    o[0] = renderUnit(sx*f), o[1] = renderUnit(sy*f), o[2] = renderUnit(f);
+}
+
+static inline void renderHit(uchar* o, const render_job* j, const uint face, const uchar v)
+{
+    o[0] = j->lit[face][j->rgb[v][0]];
+    o[1] = j->lit[face][j->rgb[v][1]];
+    o[2] = j->lit[face][j->rgb[v][2]];
+}
+
+// ray() in f0, face 0,1,2 are the 0.9,1.0,0.8 multipliers for x,y,z
+void renderRay(uchar* o, const render_job* j, const vec rd, const float sx, const float sy)
+{
+    const uchar* vx = j->voxels;
+    const vec look = j->cam.pos;
+    vec pos = look;
+
+    const vec dir = (vec){rd.x >= 0.f ? 1.f : -1.f, rd.y >= 0.f ? 1.f : -1.f, rd.z >= 0.f ? 1.f : -1.f};
+    const vec dir2 = (vec){dir.x * 0.5f, dir.y * 0.5f, dir.z * 0.5f};
+    const vec dist_per = (vec){dir.x / rd.x, dir.y / rd.y, dir.z / rd.z};
+    vec dist_remaining;
+
+    if(pos.x < -0.5f || pos.x > 127.5f || pos.y < -0.5f || pos.y > 127.5f || pos.z < -0.5f || pos.z > 127.5f)
+    {
+        // outside the volume, skip ahead to where the ray enters it
+        vec md = (vec){0.f, 0.f, 0.f};
+        if(pos.x < -0.5f){md.x = -((pos.x + 0.5f) / rd.x);}
+        else if(pos.x > 127.5f){md.x = -((pos.x - 127.5f) / rd.x);}
+        if(pos.y < -0.5f){md.y = -((pos.y + 0.5f) / rd.y);}
+        else if(pos.y > 127.5f){md.y = -((pos.y - 127.5f) / rd.y);}
+        if(pos.z < -0.5f){md.z = -((pos.z + 0.5f) / rd.z);}
+        else if(pos.z > 127.5f){md.z = -((pos.z - 127.5f) / rd.z);}
+        if(md.x < 0.f || md.y < 0.f || md.z < 0.f)
+        {
+            o[0] = renderUnit(sx), o[1] = renderUnit(sy), o[2] = renderUnit(0.5f);
+            return;
+        }
+
+        float w = md.x;
+        if(w < md.y){w = md.y;}
+        if(w < md.z){w = md.z;}
+
+        pos.x += w * rd.x;
+        pos.y += w * rd.y;
+        pos.z += w * rd.z;
+
+        dist_remaining.x = (((dir.x + 1.f) * 0.5f) - ((pos.x + 0.5f) - floorf(pos.x + 0.5f))) / rd.x;
+        dist_remaining.y = (((dir.y + 1.f) * 0.5f) - ((pos.y + 0.5f) - floorf(pos.y + 0.5f))) / rd.y;
+        dist_remaining.z = (((dir.z + 1.f) * 0.5f) - ((pos.z + 0.5f) - floorf(pos.z + 0.5f))) / rd.z;
+
+        uchar v;
+        if(w == md.x)
+        {
+            if(pos.y < -0.5f || pos.y > 127.5f || pos.z < -0.5f || pos.z > 127.5f){goto edge;}
+            dist_remaining.x = dist_per.x;
+            v = renderVoxel(vx, pos.x + dir2.x, pos.y, pos.z);
+        }
+        else if(w == md.y)
+        {
+            if(pos.x < -0.5f || pos.x > 127.5f || pos.z < -0.5f || pos.z > 127.5f){goto edge;}
+            dist_remaining.y = dist_per.y;
+            v = renderVoxel(vx, pos.x, pos.y + dir2.y, pos.z);
+        }
+        else
+        {
+            if(pos.x < -0.5f || pos.x > 127.5f || pos.y < -0.5f || pos.y > 127.5f){goto edge;}
+            dist_remaining.z = dist_per.z;
+            v = renderVoxel(vx, pos.x, pos.y, pos.z + dir2.z);
+        }
+        if(j->solid[v] == 1){renderHit(o, j, 1, v); return;}
+    }
+    else
+    {
+        dist_remaining.x = (((dir.x + 1.f) * 0.5f) - ((pos.x + 0.5f) - floorf(pos.x + 0.5f))) / rd.x;
+        dist_remaining.y = (((dir.y + 1.f) * 0.5f) - ((pos.y + 0.5f) - floorf(pos.y + 0.5f))) / rd.y;
+        dist_remaining.z = (((dir.z + 1.f) * 0.5f) - ((pos.z + 0.5f) - floorf(pos.z + 0.5f))) / rd.z;
+    }
+
+    for(uint i = 0; i < 512; i++)
+    {
+        uint face;
+        uchar v;
+        if(dist_remaining.x < dist_remaining.y && dist_remaining.x < dist_remaining.z)
+        {
+            pos.x += rd.x * dist_remaining.x;
+            pos.y += rd.y * dist_remaining.x;
+            pos.z += rd.z * dist_remaining.x;
+            dist_remaining.y -= dist_remaining.x;
+            dist_remaining.z -= dist_remaining.x;
+            dist_remaining.x = dist_per.x;
+            if(pos.x + dir.x > 127.7f || pos.x + dir.x < -0.7f){renderFog(o, sx, sy, look, pos); return;}
+            v = renderVoxel(vx, pos.x + dir2.x, pos.y, pos.z);
+            face = 0;
+        }
+        else if(dist_remaining.y < dist_remaining.z)
+        {
+            pos.x += rd.x * dist_remaining.y;
+            pos.y += rd.y * dist_remaining.y;
+            pos.z += rd.z * dist_remaining.y;
+            dist_remaining.x -= dist_remaining.y;
+            dist_remaining.z -= dist_remaining.y;
+            dist_remaining.y = dist_per.y;
+            if(pos.y + dir.y > 127.7f || pos.y + dir.y < -0.7f){renderFog(o, sx, sy, look, pos); return;}
+            v = renderVoxel(vx, pos.x, pos.y + dir2.y, pos.z);
+            face = 1;
+        }
+        else
+        {
+            pos.x += rd.x * dist_remaining.z;
+            pos.y += rd.y * dist_remaining.z;
+            pos.z += rd.z * dist_remaining.z;
+            dist_remaining.x -= dist_remaining.z;
+            dist_remaining.y -= dist_remaining.z;
+            dist_remaining.z = dist_per.z;
+            if(pos.z + dir.z > 127.7f || pos.z + dir.z < -0.7f){renderFog(o, sx, sy, look, pos); return;}
+            v = renderVoxel(vx, pos.x, pos.y, pos.z + dir2.z);
+            face = 2;
+        }
+        if(j->solid[v] == 1){renderHit(o, j, face, v); return;}
+    }
+
+    // out of steps, the shader leaves gl_FragColor unwritten here
+    o[0] = 0, o[1] = 0, o[2] = 0;
+    return;
+edge:
+    o[0] = renderUnit(sx), o[1] = renderUnit(sy), o[2] = 0;
+}
+
+// only the ray setup is batched, 8 rays at a time in flat arrays so the
+// compiler can vectorise the sums at the top of main() in f0. The march
+// is scalar, one ray at a time, every ray branches its own way through
+// the grid and has to step exactly like the shader does.
+int renderWorker(void* data)
+{
+    render_job* j = data;
+    const render_camera* c = &j->cam;
+    float px[RENDER_PACKET], sx[RENDER_PACKET];
+    float dx[RENDER_PACKET], dy[RENDER_PACKET], dz[RENDER_PACKET];
+    while(1)
+    {
+        const int t = SDL_AtomicAdd(&j->next, 1);
+        if(t >= j->tw*j->th){break;}
+        const uint x0 = (t % j->tw) * RENDER_TILE, y0 = (t / j->tw) * RENDER_TILE;
+        uint x1 = x0 + RENDER_TILE, y1 = y0 + RENDER_TILE;
+        if(x1 > j->w){x1 = j->w;}
+        if(y1 > j->h){y1 = j->h;}
+        for(uint y = y0; y < y1; y++)
+        {
+            // main() in f0 with gl_FragCoord at the pixel center, gl rows
+            // count up from the bottom and image rows down from the top
+            const float sy = 1.f - (((float)(j->h-1-y) + 0.5f) * c->ypixel);
+            const float py = (1.f - (sy * 2.f)) * c->yscale;
+            const float ux = c->forward.x + c->up.x*py;
+            const float uy = c->forward.y + c->up.y*py;
+            const float uz = c->forward.z + c->up.z*py;
+            for(uint x = x0; x < x1; x += RENDER_PACKET)
+            {
+                uint n = x1 - x;
+                if(n > RENDER_PACKET){n = RENDER_PACKET;}
+                for(uint i = 0; i < RENDER_PACKET; i++)
+                {
+                    sx[i] = ((float)(x+i) + 0.5f) * c->xpixel;
+                    px[i] = ((sx[i] * 2.f) - 1.f) * c->xscale;
+                    dx[i] = ux + c->right.x*px[i];
+                    dy[i] = uy + c->right.y*px[i];
+                    dz[i] = uz + c->right.z*px[i];
+                }
+                uchar* o = j->px + ((size_t)y*j->w + x)*3;
+                for(uint i = 0; i < n; i++, o += 3)
+                    renderRay(o, j, (vec){dx[i], dy[i], dz[i]}, sx[i], sy);
+            }
+        }
+    }
+    return 0;
+}
+
+// render a w*h rgb image of `s` from camera `c` on `threads` threads (0 = all cores)
+void renderImage(uchar* px, const game_state* s, const render_camera* c, const uint w, const uint h, uint threads)
+{
+    render_job* j = malloc(sizeof(render_job));
+    if(j == NULL){return;}
+    PROF_BEGIN(PROF_RENDER);
+    memset(j, 0, sizeof(render_job));
+    j->voxels = s->voxels;
+    j->cam = *c;
+    j->px = px;
+    j->w = w, j->h = h;
+    j->tw = (w + RENDER_TILE-1) / RENDER_TILE;
+    j->th = (h + RENDER_TILE-1) / RENDER_TILE;
+
+    // the same texel colors the has_changed rebuild writes into sVoxel
+    for(uint v = 1; v < 256; v++)
+    {
+        const uint c = v <= 39 ? s->colors[v-1] : 0;
+        j->rgb[v][0] = (c >> 16) & 0xFF, j->rgb[v][1] = (c >> 8) & 0xFF, j->rgb[v][2] = c & 0xFF;
+        j->solid[v] = 1;
+    }
+    const float mul[3] = {0.9f, 1.f, 0.8f};
+    for(uint f = 0; f < 3; f++)
+        for(uint b = 0; b < 256; b++){j->lit[f][b] = renderUnit(((float)b / 255.f) * mul[f]);}
+
+    if(threads == 0){threads = SDL_GetCPUCount();}
+    if(threads > 64){threads = 64;}
+    if(threads > j->tw*j->th){threads = j->tw*j->th;}
+    SDL_Thread* pool[64];
+    for(uint i = 1; i < threads; i++){pool[i] = SDL_CreateThread(renderWorker, "render", j);}
+    renderWorker(j);
+    for(uint i = 1; i < threads; i++){SDL_WaitThread(pool[i], NULL);}
+    free(j);
+    PROF_END(PROF_RENDER);
+}
+
+//*************************************
+// image output
+//*************************************
+// rgb pixels to png, or binary ppm when the path ends in .ppm
+uint writeImage(const char* path, const uchar* px, const uint w, const uint h)
+{
+    FILE* f = exportOpen(path);
+    if(f == NULL){return 0;}
+    const size_t len = strlen(path);
+    if(len > 4 && strcmp(path+len-4, ".ppm") == 0)
+    {
+        fprintf(f, "P6\n%u %u\n255\n", w, h);
+        fwrite(px, 1, (size_t)w*h*3, f);
+    }
+    else
+    {
+        size_t pl;
+        uchar* png = pngEncode(px, w, h, 3, &pl);
+        fwrite(png, 1, pl, f);
+        free(png);
+    }
+    uint r = ferror(f) == 0;
+    r &= fclose(f) == 0;
+    return r;
+}
+
+// read back a png or binary ppm as rgb, returns a malloc'd buffer or NULL
+uchar* readImage(const char* path, uint* w, uint* h)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL){return NULL;}
+    uchar* px = NULL;
+    uint max = 0;
+    if(fscanf(f, "P6 %u %u %u", w, h, &max) == 3 && max == 255 && *w > 0 && *h > 0 && *w <= 16384 && *h <= 16384)
+    {
+        fgetc(f); // the single whitespace before the pixels
+        const size_t n = (size_t)*w*(*h)*3;
+        px = malloc(n);
+        if(px != NULL && fread(px, 1, n, f) != n){free(px); px = NULL;}
+    }
+    else
+    {
+        fseek(f, 0, SEEK_END);
+        const long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        uchar* d = len > 0 ? malloc(len) : NULL;
+        if(d != NULL && fread(d, 1, len, f) == (size_t)len){px = pngDecode(d, len, w, h);}
+        free(d);
+    }
+    fclose(f);
+    return px;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Stroke functions.
+
+    Holding place, delete or replace draws a stroke. After the repeat
+    delay every mouse motion event is picked with the view that event
+    implies, and once a frame when the player or the arrow keys moved the
+    view. A still view is not picked again, except that delete digs on
+    every 0.1 seconds like it always has. The brush is stamped along a 3D
+    line from the last hit to the new one so a fast flick leaves no gaps.
+    Every stamp goes through the edit API so the frame uploads once, and
+    the stroke is one undo step.
+
+    A place stroke skips hits on voxels it placed itself, otherwise every
+    sample would build toward the camera off the one before.
+*/
+
+#ifndef STROKE_H
+#define STROKE_H
+
+int stroke_op = -1;         // BRUSH_PLACE, BRUSH_DELETE or BRUSH_PAINT while held
+uint stroke_has = 0;        // stroke_last holds the last stamp
+int stroke_last[3];
+float stroke_xrot, stroke_yrot; // the view of the last sample
+vec stroke_pp;
+float stroke_rx = 0.f, stroke_ry = 0.f; // relative motion this frame, wayland
+float stroke_wait = 0.f;    // the click's repeat delay, the view is not followed before it
+float stroke_dig = 0.f;     // a held delete digs again at this time when the view is still
+
+static inline float strokePitch(float y)
+{
+    if(g.plock == 1){return y > 3.11f ? 3.11f : y < 0.03f ? 0.03f : y;}
+    return y > 3.14f ? 3.14f : y < 0.1f ? 0.1f : y;
+}
+
+// stamp from the last hit to `c`, 26-connected
+static void strokeLine(const uint op, const int c[3])
+{
+    if(stroke_has == 0){brushStamp(op, c);}
+    else
+    {
+        const int d[3] = {c[0]-stroke_last[0], c[1]-stroke_last[1], c[2]-stroke_last[2]};
+        int n = abs(d[0]);
+        if(abs(d[1]) > n){n = abs(d[1]);}
+        if(abs(d[2]) > n){n = abs(d[2]);}
+        for(int i = 1; i <= n; i++)
+        {
+            const int p[3] = {stroke_last[0] + (int)roundf((float)(d[0]*i)/n),
+                              stroke_last[1] + (int)roundf((float)(d[1]*i)/n),
+                              stroke_last[2] + (int)roundf((float)(d[2]*i)/n)};
+            brushStamp(op, p);
+        }
+    }
+    stroke_last[0] = c[0], stroke_last[1] = c[1], stroke_last[2] = c[2];
+    stroke_has = 1;
+}
+
+// pick with the view at (xrot, yrot) and extend the stroke to the hit
+static void strokePick(const float xrot, const float yrot)
+{
+    stroke_xrot = xrot, stroke_yrot = yrot, stroke_pp = g.pp;
+    if(stroke_op == BRUSH_DELETE){stroke_dig = t+0.1f;}
+
+    // the ray reads look_dir and ipp, give it this sample's view and
+    // position, ipp is otherwise last frame's until the render sets it
+    const vec ld = look_dir;
+    mat v;
+    mIdent(&v);
+    mRotate(&v, yrot, 1.f, 0.f, 0.f);
+    mRotate(&v, xrot, 0.f, 0.f, 1.f);
+    mGetViewZ(&look_dir, v);
+    if(g.plock == 1)
+    {
+        look_dir.z = -0.001f;
+        vNorm(&look_dir);
+    }
+    ipp = g.pp;
+    vInv(&ipp);
+    traceViewPath(stroke_op == BRUSH_PLACE);
+    look_dir = ld;
+
+    // the undo shadow is the grid as the stroke started, a face that
+    // lands inside another voxel is a grazing pick along the surface
+    if(stroke_op == BRUSH_PLACE && lray > -1)
+    {
+        if(undo_shadow != NULL && undo_shadow[lray] == 0){return;}
+        if(g.pb.w == 1.f && isInBounds(g.pb) == 1 && g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] != 0){return;}
+    }
+    int c[3];
+    if(brushCentre(stroke_op, c) == 0){return;}
+    strokeLine(stroke_op, c);
+}
+void strokeSample(const float xrot, const float yrot)
+{
+    if(stroke_op < 0 || t < stroke_wait){return;}
+    const uint still = xrot == stroke_xrot && yrot == stroke_yrot &&
+        g.pp.x == stroke_pp.x && g.pp.y == stroke_pp.y && g.pp.z == stroke_pp.z;
+    if(still == 1 && (stroke_op != BRUSH_DELETE || t < stroke_dig)){return;}
+    strokePick(xrot, yrot);
+}
+
+// a button or key went down, a repeat of the held one carries on. The
+// first stamp is the click, the stroke only follows the view after the
+// repeat delay so a little mouse jitter doesn't smear it, and then draws
+// from the click to wherever the view got to.
+void strokeBegin(const uint op)
+{
+    if(stroke_op == (int)op){return;}
+    undoCommit(); // a stroke switching op starts another undo step
+    stroke_op = op;
+    stroke_has = 0;
+    stroke_wait = t+rrsp;
+    strokePick(g.xrot, g.yrot);
+}
+void strokeEnd(const uint op)
+{
+    if(stroke_op == (int)op){stroke_op = -1;}
+}
+
+// a mouse motion event, the view it leads to is where the frame ends up
+// if it's the last one. Absolute positions are from the centre the mouse
+// was warped to, wayland reports relative motion.
+void strokeMotion(const SDL_MouseMotionEvent* e, const float lx, const float ly)
+{
+    if(wayland == 1)
+    {
+        stroke_rx += e->xrel, stroke_ry += e->yrel;
+        if(stroke_op < 0){return;}
+        strokeSample(g.xrot - stroke_rx*g.sens, strokePitch(g.yrot - stroke_ry*g.sens));
+        return;
+    }
+    if(stroke_op < 0){return;}
+    strokeSample(g.xrot + (lx-e->x)*g.sens, strokePitch(g.yrot + (ly-e->y)*g.sens));
+}
+
+// once a frame, picks when the view moved or a held delete is due to dig
+void strokeFrame()
+{
+    stroke_rx = 0.f, stroke_ry = 0.f;
+    strokeSample(g.xrot, g.yrot);
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Symmetry functions.
+
+    Any mix of x, y and z mirror planes plus N-fold radial copies around
+    the z axis through the x and y planes. An edit asks symPoints() for
+    every image of where it lands and applies itself at each one, a paste
+    asks for every voxel it pastes. All the copies go through the edit API
+    so however many there are it is still a single texture upload.
+
+    The planes default to the old mirror brush, a voxel at x reflects to
+    128-x. O moves them to the pointed spot.
+*/
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#define SYM_FOLDS 7
+#define SYM_MAX 128 // 16 radial copies by 8 mirror images
+
+enum{SYM_X = 1, SYM_Y = 2, SYM_Z = 4};
+uint sym_axes = 0;                  // mirror planes that are on
+int sym_c2[3] = {128, 128, 128};    // twice each plane's position, p reflects to c2-p
+uint sym_fold = 1;                  // radial copies, 1 is off
+const uint sym_folds[SYM_FOLDS] = {1, 2, 3, 4, 6, 8, 16};
+
+static inline uint symOn(){return sym_axes != 0 || sym_fold > 1;}
+
+// every image of (x,y,z), itself first and each once, may be out of the volume
+uint symPoints(const int x, const int y, const int z, int p[SYM_MAX][3])
+{
+    uint n = 0;
+    const float cx = (float)sym_c2[0]*0.5f, cy = (float)sym_c2[1]*0.5f;
+    for(uint k = 0; k < sym_fold; k++)
+    {
+        int rx = x, ry = y;
+        if(k > 0)
+        {
+            const float a = 6.28318531f * (float)k / (float)sym_fold;
+            const float c = cosf(a), s = sinf(a), dx = x-cx, dy = y-cy;
+            rx = roundf(cx + dx*c - dy*s);
+            ry = roundf(cy + dx*s + dy*c);
+        }
+        for(uint m = 0; m < 8; m++)
+        {
+            if((m & sym_axes) != m){continue;}
+            const int q[3] = {m & SYM_X ? sym_c2[0]-rx : rx, m & SYM_Y ? sym_c2[1]-ry : ry, m & SYM_Z ? sym_c2[2]-z : z};
+            uint j = 0;
+            for(NULL; j < n; j++){if(p[j][0] == q[0] && p[j][1] == q[1] && p[j][2] == q[2]){break;}}
+            if(j < n){continue;}
+            p[n][0] = q[0], p[n][1] = q[1], p[n][2] = q[2];
+            n++;
+        }
+    }
+    return n;
+}
+
+//*************************************
+// editor
+//*************************************
+void symMessage()
+{
+    if(symOn() == 0){sprintf(warnm, "Symmetry off."); wti = t+1.f; return;}
+    char* w = warnm + sprintf(warnm, "Symmetry");
+    if(sym_axes & SYM_X){w += sprintf(w, " X");}
+    if(sym_axes & SYM_Y){w += sprintf(w, " Y");}
+    if(sym_axes & SYM_Z){w += sprintf(w, " Z");}
+    if(sym_fold > 1){w += sprintf(w, " radial %u", sym_fold);}
+    sprintf(w, " at %.1f %.1f %.1f.", sym_c2[0]*0.5f, sym_c2[1]*0.5f, sym_c2[2]*0.5f);
+    wti = t+1.f;
+}
+
+// R, 8 and 9 toggle the x, y and z planes
+void symToggle(const uint axis)
+{
+    sym_axes ^= axis;
+    symMessage();
+}
+
+// 0 steps through the radial copies
+void symFold()
+{
+    uint i = 0;
+    while(i < SYM_FOLDS-1 && sym_folds[i] != sym_fold){i++;}
+    sym_fold = sym_folds[(i+1) % SYM_FOLDS];
+    symMessage();
+}
+
+// O puts the planes through `p`, again on the same spot puts them back
+void symCentre(const vec p)
+{
+    const int c[3] = {(int)p.x*2, (int)p.y*2, (int)p.z*2};
+    if(c[0] == sym_c2[0] && c[1] == sym_c2[1] && c[2] == sym_c2[2]){sym_c2[0] = sym_c2[1] = sym_c2[2] = 128;}
+    else{sym_c2[0] = c[0], sym_c2[1] = c[1], sym_c2[2] = c[2];}
+    symMessage();
+}
+
+#endif
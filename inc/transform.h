@@ -0,0 +1,322 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Transform functions.
+
+    Quarter turns, flips and shifts of the whole 128³ grid. A turn or
+    flip moves each voxel to an index that is linear in x, y and z, so one
+    kernel does them all from a table of strides: when x rows stay x rows
+    it is a row copy, otherwise 16x16 tiles are transposed so every line
+    is read and written whole. A shift is row copies. Each goes
+    through a scratch grid and back, a few milliseconds for the volume.
+
+    Hollow strips the interior a solid model never shows, solidify fills
+    it back in.
+
+    `./wox transform` runs them on saved projects.
+*/
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#define XFORM_BLOCK 16
+
+enum{XFORM_X, XFORM_Y, XFORM_Z};
+const char xform_axes[3] = {'X', 'Y', 'Z'};
+uchar* xform_scratch = NULL;
+
+// dst[off + x*sx + y*sy + z*sz] = src[PTI(x,y,z)]
+static void xformRemap(uchar* dst, const uchar* src, const int off, const int sx, const int sy, const int sz)
+{
+    if(sx == 1 || sx == -1)
+    {
+        for(int z = 0; z < 128; z++)
+        {
+            for(int y = 0; y < 128; y++)
+            {
+                uchar* d = dst + off + y*sy + z*sz;
+                const uchar* s = src + PTI(0, y, z);
+                if(sx == 1){memcpy(d, s, 128); continue;}
+                for(int x = 0; x < 128; x++){d[-x] = s[x];}
+            }
+        }
+        return;
+    }
+
+    // x goes to the source axis that is now a dst row, swap the two a
+    // 16x16 tile at a time so every line is read and written whole, a
+    // straight scatter has 16 KB strides that alias in L1
+    const uint iy = sy == 1 || sy == -1;  // y is the axis that lands on dst rows, else z
+    const int si = iy == 1 ? sy : sz, so = iy == 1 ? sz : sy;
+    uchar tile[XFORM_BLOCK][XFORM_BLOCK];
+    for(int o = 0; o < 128; o++)
+    {
+        for(int bi = 0; bi < 128; bi += XFORM_BLOCK)
+        {
+            for(int bx = 0; bx < 128; bx += XFORM_BLOCK)
+            {
+                for(int i = 0; i < XFORM_BLOCK; i++)
+                    memcpy(tile[i], src + (iy == 1 ? PTI(bx, bi+i, o) : PTI(bx, o, bi+i)), XFORM_BLOCK);
+                for(int x = 0; x < XFORM_BLOCK; x++)
+                {
+                    uchar* d = dst + off + (bx+x)*sx + o*so + bi*si;
+                    for(int i = 0; i < XFORM_BLOCK; i++){d[i*si] = tile[i][x];}
+                }
+            }
+        }
+    }
+}
+
+static uint xformScratch()
+{
+    if(xform_scratch == NULL){xform_scratch = malloc(max_voxels);}
+    return xform_scratch != NULL;
+}
+
+// a quarter turn, counter clockwise looking back down the axis
+uint volRotate(game_state* s, const uint axis)
+{
+    if(xformScratch() == 0){return 0;}
+    if(     axis == XFORM_X){xformRemap(xform_scratch, s->voxels, 127*128,   1,      16384, -128);}  // y' = 127-z, z' = y
+    else if(axis == XFORM_Y){xformRemap(xform_scratch, s->voxels, 127*16384, -16384, 128,   1);}     // z' = 127-x, x' = z
+    else                    {xformRemap(xform_scratch, s->voxels, 127,       128,    -1,    16384);} // x' = 127-y, y' = x
+    editCopy(s, 0, xform_scratch, max_voxels);
+    return 1;
+}
+
+uint volFlip(game_state* s, const uint axis)
+{
+    if(xformScratch() == 0){return 0;}
+    if(     axis == XFORM_X){xformRemap(xform_scratch, s->voxels, 127,       -1, 128,  16384);}
+    else if(axis == XFORM_Y){xformRemap(xform_scratch, s->voxels, 127*128,   1,  -128, 16384);}
+    else                    {xformRemap(xform_scratch, s->voxels, 127*16384, 1,  128,  -16384);}
+    editCopy(s, 0, xform_scratch, max_voxels);
+    return 1;
+}
+
+// move everything by (dx,dy,dz), what leaves one side comes back on the
+// other with `wrap` or is dropped without it
+uint volShift(game_state* s, const int dx, const int dy, const int dz, const uint wrap)
+{
+    if(xformScratch() == 0){return 0;}
+    const int wx = dx & 127;
+    for(int z = 0; z < 128; z++)
+    {
+        for(int y = 0; y < 128; y++)
+        {
+            uchar* d = xform_scratch + PTI(0, y, z);
+            int fy = y-dy, fz = z-dz;
+            if(wrap == 1){fy &= 127, fz &= 127;}
+            else if(fy < 0 || fz < 0 || fy > 127 || fz > 127 || dx >= 128 || dx <= -128){memset(d, 0, 128); continue;}
+            const uchar* r = s->voxels + PTI(0, fy, fz);
+            if(wrap == 1)
+            {
+                memcpy(d + wx, r, 128-wx);
+                memcpy(d, r + 128-wx, wx);
+            }
+            else if(dx >= 0)
+            {
+                memset(d, 0, dx);
+                memcpy(d + dx, r, 128-dx);
+            }
+            else
+            {
+                memcpy(d, r - dx, 128+dx);
+                memset(d + 128+dx, 0, -dx);
+            }
+        }
+    }
+    editCopy(s, 0, xform_scratch, max_voxels);
+    return 1;
+}
+
+//*************************************
+// hollow and solidify
+//*************************************
+#define HOLLOW_MAX 64 // any deeper leaves the whole 128³ as a shell anyway
+uchar* hollow_mask = NULL; // two 0 or 1 grids, ping ponged
+
+// remove the filled voxels more than `shell` steps in from an empty voxel
+// or the edge of the volume, 1 removes those with all six neighbours
+// filled. Each step erodes the mask by its six neighbours, a byte AND
+// stencil per row. `n` is the voxels removed.
+uint volHollow(game_state* s, uint shell, uint* n)
+{
+    if(hollow_mask == NULL){hollow_mask = malloc(max_voxels*2);}
+    if(hollow_mask == NULL){return 0;}
+    if(shell < 1){shell = 1;}
+    if(shell > HOLLOW_MAX){shell = HOLLOW_MAX;}
+    uchar* a = hollow_mask;
+    uchar* b = hollow_mask + max_voxels;
+    uchar* v = s->voxels;
+    for(uint i = 0; i < max_voxels; i++){a[i] = v[i] != 0;}
+    for(uint k = 0; k < shell; k++)
+    {
+        for(uint z = 0; z < 128; z++)
+        {
+            for(uint y = 0; y < 128; y++)
+            {
+                const uint r = PTI(0, y, z);
+                if(y == 0 || z == 0 || y == 127 || z == 127){memset(b+r, 0, 128); continue;}
+                b[r] = 0, b[r+127] = 0;
+                for(uint i = r+1; i < r+127; i++)
+                    b[i] = a[i] & a[i-1] & a[i+1] & a[i-128] & a[i+128] & a[i-16384] & a[i+16384];
+            }
+        }
+        uchar* sw = a;
+        a = b, b = sw;
+    }
+    uint c = 0;
+    for(uint i = 0; i < max_voxels; i++)
+        if(a[i] != 0){c += editVoxel(s, i, 0);}
+    *n = c;
+    return 1;
+}
+
+// fill every empty voxel that can't be reached from outside the volume, a
+// scanline flood over empty space from the edges, the rest of a row's run
+// takes the color of the voxel before it. `n` is the voxels filled.
+uint volSolidify(game_state* s, uint* n)
+{
+    if(flood_stack == NULL){flood_stack = malloc(FLOOD_STACK*sizeof(uint));}
+    if(flood_seen == NULL){flood_seen = malloc(max_voxels);}
+    if(flood_stack == NULL || flood_seen == NULL){return 0;}
+    uchar* v = s->voxels;
+    memset(flood_seen, 0, max_voxels);
+
+    // every empty run touching a face of the volume
+    uint sp = 0;
+    for(uint z = 0; z < 128; z++)
+    {
+        for(uint y = 0; y < 128; y++)
+        {
+            const uint r = PTI(0, y, z);
+            if(y == 0 || z == 0 || y == 127 || z == 127){sp = floodRow(v, r, 0, 127, 0, 0, sp); continue;}
+            sp = floodRow(v, r, 0, 0, 0, 0, sp);
+            sp = floodRow(v, r, 127, 127, 0, 0, sp);
+        }
+    }
+    while(sp > 0)
+    {
+        const uint e = flood_stack[--sp];
+        const uint i0 = e & 0x1FFFFF, x0 = i0 & 127, x1 = e >> 21;
+        const uint r = i0 - x0, ry = (i0 >> 7) & 127, rz = i0 >> 14;
+        if(ry > 0)  {sp = floodRow(v, r-128,   x0, x1, 0, 0, sp);}
+        if(ry < 127){sp = floodRow(v, r+128,   x0, x1, 0, 0, sp);}
+        if(rz > 0)  {sp = floodRow(v, r-16384, x0, x1, 0, 0, sp);}
+        if(rz < 127){sp = floodRow(v, r+16384, x0, x1, 0, 0, sp);}
+    }
+
+    // the outside is seen, an unseen empty voxel is enclosed and never at x 0
+    uint c = 0;
+    for(uint i = 0; i < max_voxels; i++)
+        if(v[i] == 0 && flood_seen[i] == 0){c += editVoxel(s, i, v[i-1]);}
+    *n = c;
+    return 1;
+}
+
+//*************************************
+// editor
+//*************************************
+
+// the axis the view faces most along, and which way along it
+uint xformFacing(int* dir)
+{
+    const float a[3] = {fabsf(look_dir.x), fabsf(look_dir.y), fabsf(look_dir.z)};
+    const uint axis = a[0] >= a[1] && a[0] >= a[2] ? XFORM_X : a[1] >= a[2] ? XFORM_Y : XFORM_Z;
+    const float v = axis == XFORM_X ? look_dir.x : axis == XFORM_Y ? look_dir.y : look_dir.z;
+    *dir = v < 0.f ? -1 : 1;
+    return axis;
+}
+
+enum{XFORM_ROTATE, XFORM_FLIP, XFORM_SHIFT};
+
+// F5 F6 F7 turn the volume about X Y Z, Semicolon flips it along the axis
+// faced, Minus and Equals shift it a voxel back or forward along it with wrap
+void xformEdit(const uint op, uint axis, int step)
+{
+    int dir = 1;
+    if(op != XFORM_ROTATE){axis = xformFacing(&dir);}
+    const Uint64 st = SDL_GetPerformanceCounter();
+    uint r = 0;
+    if(op == XFORM_ROTATE){r = volRotate(&g, axis);}
+    else if(op == XFORM_FLIP){r = volFlip(&g, axis);}
+    else
+    {
+        step *= dir;
+        r = volShift(&g, axis == XFORM_X ? step : 0, axis == XFORM_Y ? step : 0, axis == XFORM_Z ? step : 0, 1);
+    }
+    if(r == 0){return;}
+    const float ms = (float)(SDL_GetPerformanceCounter()-st) * 1e3f / (float)SDL_GetPerformanceFrequency();
+    if(op == XFORM_ROTATE){sprintf(warnm, "Turned the volume about %c. %.1f ms", xform_axes[axis], ms);}
+    else if(op == XFORM_FLIP){sprintf(warnm, "Flipped the volume along %c. %.1f ms", xform_axes[axis], ms);}
+    else{sprintf(warnm, "Shifted the volume %+i along %c. %.1f ms", step, xform_axes[axis], ms);}
+    wti = t+1.f;
+}
+
+// F10 hollows leaving a shell as thick as the brush radius, F11 solidifies
+void hollowEdit(const uint solidify)
+{
+    const Uint64 st = SDL_GetPerformanceCounter();
+    uint n = 0;
+    if((solidify == 1 ? volSolidify(&g, &n) : volHollow(&g, brush_size, &n)) == 0){return;}
+    const float ms = (float)(SDL_GetPerformanceCounter()-st) * 1e3f / (float)SDL_GetPerformanceFrequency();
+    prof_count.edits += n;
+    if(solidify == 1){sprintf(warnm, "Solidified %u voxels. %.1f ms", n, ms);}
+    else{sprintf(warnm, "Hollowed %u voxels leaving a shell of %u. %.1f ms", n, brush_size, ms);}
+    wti = t+1.f;
+}
+
+//*************************************
+// command line
+//*************************************
+
+// ./wox transform [-o<file.wox.gz>] <project|file.wox.gz> <op> ...
+// ops are rotx roty rotz flipx flipy flipz shift:dx,dy,dz wrap:dx,dy,dz
+// hollow[:shell] solidify
+int transformRun(int argc, char** argv)
+{
+    char tmp[16];
+    char out[1024] = {0};
+    int a = 2;
+    if(a < argc && strncmp(argv[a], "-o", 2) == 0){snprintf(out, 1024, "%s", argv[a]+2); a++;}
+    if(a+1 >= argc){printf("ERROR: transform needs a project and at least one op.\n"); return 1;}
+
+    char file[1024];
+    projectFile(file, 1024, argv[a++]);
+    if(readState(&g, file) == 0){printf("ERROR: could not load %s\n", file); return 1;}
+    if(out[0] == 0x00){snprintf(out, 1024, "%s", file);}
+
+    for(NULL; a < argc; a++)
+    {
+        const char* op = argv[a];
+        const Uint64 st = SDL_GetPerformanceCounter();
+        uint r = 0, n = 0, counted = 0;
+        int d[3] = {0};
+        if(strcmp(op, "hollow") == 0 || strncmp(op, "hollow:", 7) == 0){r = volHollow(&g, op[6] == ':' ? atoi(op+7) : 1, &n); counted = 1;}
+        else if(strcmp(op, "solidify") == 0){r = volSolidify(&g, &n); counted = 1;}
+        else if(strncmp(op, "rot", 3) == 0 && op[3] >= 'x' && op[3] <= 'z' && op[4] == 0x00){r = volRotate(&g, op[3]-'x');}
+        else if(strncmp(op, "flip", 4) == 0 && op[4] >= 'x' && op[4] <= 'z' && op[5] == 0x00){r = volFlip(&g, op[4]-'x');}
+        else if((strncmp(op, "shift:", 6) == 0 || strncmp(op, "wrap:", 5) == 0) &&
+                sscanf(strchr(op, ':')+1, "%i,%i,%i", &d[0], &d[1], &d[2]) == 3)
+        {
+            r = volShift(&g, d[0], d[1], d[2], op[0] == 'w');
+        }
+        else{printf("ERROR: unknown transform \"%s\".\n", op); return 1;}
+        if(r == 0){printf("ERROR: out of memory.\n"); return 1;}
+        timestamp(tmp);
+        const double ms = (double)(SDL_GetPerformanceCounter()-st) * 1e3 / (double)SDL_GetPerformanceFrequency();
+        if(counted == 1){printf("[%s] %s %u voxels %s %.2f ms\n", tmp, op, n, op[0] == 'h' ? "removed" : "filled", ms);}
+        else{printf("[%s] %s %.2f ms\n", tmp, op, ms);}
+    }
+
+    if(writeState(&g, out) == 0){printf("ERROR: could not write %s\n", out); return 1;}
+    timestamp(tmp);
+    printf("[%s] Saved %u voxels to %s\n", tmp, placedVoxels(), out);
+    return 0;
+}
+
+#endif
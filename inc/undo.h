@@ -0,0 +1,216 @@
+/*
+--------------------------------------------------
+    James William Fletcher (github.com/mrbid)
+         & Test_User       (notabug.org/test_user)
+            August 2023
+--------------------------------------------------
+    Undo functions.
+
+    Edits reach undo_lo/hi through editFlush(). When an action
+    ends, a click, the burst of a held button or a region op, the marked
+    span is compared with a shadow copy of the grid and only the
+    difference is kept:
+
+        u32 start, u32 length, u32 old bytes, u32 new bytes, old runs, new runs
+
+    per changed segment, with runs as (count-1, value) byte pairs and
+    gaps shorter than UNDO_GAP merged into the segment. A click costs 20
+    bytes and a 100k voxel box about 44 KB, undo and redo are memsets.
+
+    WOX_UNDO_MB caps the history (default 64), the oldest records go first.
+*/
+
+#ifndef UNDO_H
+#define UNDO_H
+
+#define UNDO_GAP 32     // unchanged voxels merged into a segment rather than starting another
+#define UNDO_MB 64
+
+typedef struct
+{
+    uchar* data;
+    uint size;      // bytes of data
+    uint lo, hi;    // voxel span it covers
+    uint voxels;    // voxels it changes
+}
+undo_record;
+
+undo_record* undo_list = NULL;
+uint undo_count = 0, undo_alloc = 0;
+uint undo_cursor = 0;   // records before this are applied, after it are redo
+size_t undo_bytes = 0, undo_cap = (size_t)UNDO_MB * 1048576;
+uchar* undo_shadow = NULL; // the grid as of the last record
+
+// a growable scratch for encoding
+uchar* undo_buf = NULL;
+size_t undo_buf_size = 0, undo_buf_len = 0;
+static inline uint undoReserve(const size_t n)
+{
+    if(undo_buf_len + n <= undo_buf_size){return 1;}
+    size_t ns = undo_buf_size == 0 ? 65536 : undo_buf_size;
+    while(ns < undo_buf_len + n){ns *= 2;}
+    uchar* nb = realloc(undo_buf, ns);
+    if(nb == NULL){return 0;}
+    undo_buf = nb, undo_buf_size = ns;
+    return 1;
+}
+static inline void undoPut32(const uint v){memcpy(undo_buf + undo_buf_len, &v, 4); undo_buf_len += 4;}
+static inline uint undoGet32(const uchar* p){uint v; memcpy(&v, p, 4); return v;}
+
+// run length encode `n` bytes, returns 0 when out of memory
+static uint undoRuns(const uchar* v, const uint n)
+{
+    if(undoReserve((size_t)n*2) == 0){return 0;}
+    for(uint i = 0; i < n;)
+    {
+        uint r = 1;
+        while(r < 256 && i+r < n && v[i+r] == v[i]){r++;}
+        undo_buf[undo_buf_len++] = r-1;
+        undo_buf[undo_buf_len++] = v[i];
+        i += r;
+    }
+    return 1;
+}
+
+// decode runs of `n` bytes into `dst`
+static void undoUnruns(const uchar* p, uchar* dst, const uint n)
+{
+    for(uint i = 0; i < n;)
+    {
+        const uint r = (uint)p[0]+1;
+        memset(dst + i, p[1], r);
+        i += r;
+        p += 2;
+    }
+}
+
+// forget everything, after a load or at start up
+void undoReset()
+{
+    for(uint i = 0; i < undo_count; i++){free(undo_list[i].data);}
+    undo_count = 0, undo_cursor = 0, undo_bytes = 0;
+    undo_lo = EDIT_NONE, undo_hi = 0;
+    if(undo_shadow == NULL)
+    {
+        const char* e = getenv("WOX_UNDO_MB");
+        if(e != NULL && atoi(e) > 0){undo_cap = (size_t)atoi(e) * 1048576;}
+        undo_shadow = malloc(max_voxels);
+    }
+    if(undo_shadow != NULL){memcpy(undo_shadow, g.voxels, max_voxels);}
+}
+
+// close the current action, call when no edit is in progress
+void undoCommit()
+{
+    editFlush();
+    if(undo_lo > undo_hi || undo_shadow == NULL){return;}
+    const uint lo = undo_lo, hi = undo_hi;
+    undo_lo = EDIT_NONE, undo_hi = 0;
+    const uchar* cur = g.voxels;
+    const uchar* old = undo_shadow;
+
+    undo_buf_len = 0;
+    uint voxels = 0, first = EDIT_NONE, last = 0;
+    for(uint i = lo; i <= hi;)
+    {
+        // skip what didn't change a block at a time
+        while(i+64 <= hi+1 && memcmp(cur+i, old+i, 64) == 0){i += 64;}
+        while(i <= hi && cur[i] == old[i]){i++;}
+        if(i > hi){break;}
+        uint e = i, gap = 0;
+        for(uint j = i+1; j <= hi; j++)
+        {
+            if(cur[j] != old[j]){e = j, gap = 0; voxels++;}
+            else if(++gap == UNDO_GAP){break;}
+        }
+        voxels++;
+        const uint n = e-i+1;
+        if(undoReserve(16) == 0){goto oom;}
+        const size_t h = undo_buf_len;
+        undoPut32(i);
+        undoPut32(n);
+        undoPut32(0);
+        undoPut32(0);
+        if(undoRuns(old+i, n) == 0){goto oom;}
+        const uint obytes = undo_buf_len - h - 16;
+        if(undoRuns(cur+i, n) == 0){goto oom;}
+        const uint nbytes = undo_buf_len - h - 16 - obytes;
+        memcpy(undo_buf + h + 8, &obytes, 4);
+        memcpy(undo_buf + h + 12, &nbytes, 4);
+        if(i < first){first = i;}
+        last = e;
+        i = e+1;
+    }
+    if(undo_buf_len == 0){return;}
+
+    // a new action drops the redo records
+    for(uint i = undo_cursor; i < undo_count; i++){undo_bytes -= undo_list[i].size; free(undo_list[i].data);}
+    undo_count = undo_cursor;
+    if(undo_count == undo_alloc)
+    {
+        const uint na = undo_alloc == 0 ? 256 : undo_alloc*2;
+        undo_record* nl = realloc(undo_list, na*sizeof(undo_record));
+        if(nl == NULL){goto oom;}
+        undo_list = nl, undo_alloc = na;
+    }
+    undo_record* r = &undo_list[undo_count];
+    r->data = malloc(undo_buf_len);
+    if(r->data == NULL){goto oom;}
+    memcpy(r->data, undo_buf, undo_buf_len);
+    r->size = undo_buf_len, r->lo = first, r->hi = last, r->voxels = voxels;
+    undo_count++;
+    undo_cursor = undo_count;
+    undo_bytes += r->size;
+    memcpy(undo_shadow+lo, cur+lo, hi-lo+1);
+
+    // keep under the cap, oldest first but never the newest
+    uint drop = 0;
+    while(undo_bytes > undo_cap && drop+1 < undo_count){undo_bytes -= undo_list[drop].size; free(undo_list[drop].data); drop++;}
+    if(drop > 0)
+    {
+        memmove(undo_list, undo_list+drop, (undo_count-drop)*sizeof(undo_record));
+        undo_count -= drop;
+        undo_cursor -= drop;
+    }
+    return;
+
+oom:
+    // can't record it, so history before this point no longer lines up
+    undoReset();
+}
+
+// write a record's old (redo == 0) or new values into the grid and shadow
+static void undoApply(const undo_record* r, const uint redo)
+{
+    const uchar* p = r->data;
+    const uchar* end = r->data + r->size;
+    while(p < end)
+    {
+        const uint start = undoGet32(p), n = undoGet32(p+4);
+        const uint obytes = undoGet32(p+8), nbytes = undoGet32(p+12);
+        p += 16;
+        undoUnruns(redo == 1 ? p + obytes : p, g.voxels + start, n);
+        p += obytes + nbytes;
+        memcpy(undo_shadow + start, g.voxels + start, n);
+        markDirty(start, start+n-1); // the next commit finds the shadow already agrees
+    }
+}
+
+// returns the voxels changed, 0 when there is nothing to undo
+uint undo()
+{
+    undoCommit();
+    if(undo_cursor == 0){return 0;}
+    undo_cursor--;
+    undoApply(&undo_list[undo_cursor], 0);
+    return undo_list[undo_cursor].voxels;
+}
+uint redo()
+{
+    undoCommit();
+    if(undo_cursor == undo_count){return 0;}
+    undoApply(&undo_list[undo_cursor], 1);
+    return undo_list[undo_cursor++].voxels;
+}
+
+#endif
@@ -8,7 +8,17 @@
     Colour Converter: https://www.easyrgb.com
 */
 #include "inc/excess.h"
-//#define BENCH_FPS
+#include "inc/symmetry.h"
+#include "inc/region.h"
+#include "inc/brush.h"
+#include "inc/transform.h"
+#include "inc/undo.h"
+#include "inc/stroke.h"
+#include "inc/export.h"
+#include "inc/render.h"
+#include "inc/headless.h"
+#include "inc/bench.h"
+#include "inc/regress.h"
 void WOX_QUIT()
 {
     SDL_HideWindow(wnd);
@@ -35,6 +45,7 @@ void WOX_POP(const int w, const int h)
         yscale = (float)winh/(float)winw;
     }
     glUniform2f(scale_id, xscale, yscale);
+    glUniform2f(pixel_id, 1.f/(float)winw, 1.f/(float)winh);
     doPerspective();
 }
 static SDL_HitTestResult SDLCALL hitTest(SDL_Window *window, const SDL_Point *pt, void *data)
@@ -45,8 +56,11 @@ static SDL_HitTestResult SDLCALL hitTest(SDL_Window *window, const SDL_Point *pt
     return SDL_HITTEST_NORMAL;
 }
 void drawHud(uint type);
+void drawStats();
 void main_loop()
 {
+    PROF_BEGIN(PROF_FRAME);
+
     // time delta
     static float lt = 0;
     t = fTime();
@@ -60,26 +74,22 @@ void main_loop()
         static float ft = 0.f;
         if(t > ft)
         {
+            static Uint64 gn = 0, gf = 0;
             g_fps = fc/3;
-#ifdef BENCH_FPS
-            static uint count = 0;
-            count++;
-            if(count > 2){exit(0);}
-            printf("%u\n", g_fps);
-#endif
+            g_gpums = prof_count.gpu_frames == gf ? 0.f : (float)((double)(prof_count.gpu_ns - gn) * 1e-6 / (double)(prof_count.gpu_frames - gf));
+            gn = prof_count.gpu_ns;
+            gf = prof_count.gpu_frames;
             fc = 0;
             ft = t+3.f;
         }
         fc++;
     }
-#ifdef BENCH_FPS
-    return;
-#endif
 
     // input handling
     static float idle = 0.f;
 
-    // if user is idle for 3 minutes, save.
+    // if user is idle for 3 minutes, save. The camera, palette and speeds
+    // are in the save too, so it backs up whether or not voxels changed.
     if(idle != 0.f && t-idle > 180.f)
     {
         saveState(openTitle, ".idle", load_state);
@@ -100,7 +110,7 @@ void main_loop()
             winh = h+(my-dsy);
             dsx = mx;
             dsy = my;
-            if(winw > 400 && winh > 380)
+            if(winw > 400 && winh > 410) // leaves the help panel clear of the title bar
             {
                 SDL_SetWindowSize(wnd, winw, winh);
                 winw2 = winw/2;
@@ -111,10 +121,14 @@ void main_loop()
         }
     }
 
+    PROF_BEGIN(PROF_INPUT);
     static uint last_focus_mouse = 0;
     SDL_Event event;
     while(SDL_PollEvent(&event))
     {
+        if(event.type == SDL_KEYDOWN || event.type == SDL_KEYUP || event.type == SDL_MOUSEMOTION ||
+           event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP || event.type == SDL_MOUSEWHEEL)
+            latInput(event.common.timestamp);
         switch(event.type)
         {
             case SDL_WINDOWEVENT:
@@ -204,19 +218,18 @@ void main_loop()
                     traceViewPath(0);
                     if(lray > -1 && g.voxels[lray] > 7)
                     {
-                        g.voxels[lray]--;
-                        g.st = g.voxels[lray];
-                        if(g.st < 8.f || g.colors[g.voxels[lray]] == 0)
+                        uchar v = g.voxels[lray]-1;
+                        if(v < 8 || g.colors[v] == 0)
                         {
                             if(g.colors[0] != 0)
                             {
                                 uint i = 7;
                                 for(NULL; i < 40 && g.colors[i] != 0; i++){}
-                                g.st = (float)(i-1);
-                                g.voxels[lray] = i-1;
-                                has_changed = 1;
+                                v = i-1;
                             }
                         }
+                        g.st = v;
+                        prof_count.edits += editVoxel(&g, lray, v);
                         updateSelectColor();
                     }
                     else
@@ -229,7 +242,6 @@ void main_loop()
                                 uint i = 7;
                                 for(NULL; i < 40 && g.colors[i] != 0; i++){}
                                 g.st = (float)(i-1);
-                                has_changed = 1;
                             }
                         }
                         updateSelectColor();
@@ -240,14 +252,10 @@ void main_loop()
                     traceViewPath(0);
                     if(lray > -1 && g.voxels[lray] > 7)
                     {
-                        g.voxels[lray]++;
-                        g.st = g.voxels[lray];
-                        if(g.st > 39.f || g.colors[g.voxels[lray]] == 0)
-                        {
-                            g.st = 8.f;
-                            g.voxels[lray] = g.st;
-                            has_changed = 1;
-                        }
+                        uchar v = g.voxels[lray]+1;
+                        if(v > 39 || g.colors[v] == 0){v = 8;}
+                        g.st = v;
+                        prof_count.edits += editVoxel(&g, lray, v);
                         updateSelectColor();
                     }
                     else
@@ -259,36 +267,11 @@ void main_loop()
                 }
                 else if(event.key.keysym.sym == SDLK_RSHIFT) // place a voxel
                 {
-                    ptt = t+rrsp;
-                    traceViewPath(1);
-                    if(lray > -1)
-                    {
-                        if(g.pb.w == 1 && isInBounds(g.pb) && g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] == 0)
-                        {
-                            g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] = g.st;
-                            if(mirror == 1)
-                            {
-                                const float x = g.pb.x > 64.f ? 64.f+(64.f-g.pb.x) : 64.f + (64.f-g.pb.x);
-                                g.voxels[PTI(x, g.pb.y, g.pb.z)] = g.st;
-                            }
-                            has_changed = 1;
-                        }
-                    }
+                    strokeBegin(BRUSH_PLACE);
                 }
                 else if(event.key.keysym.sym == SDLK_RCTRL) // remove pointed voxel
                 {
-                    dtt = t+rrsp;
-                    traceViewPath(0);
-                    if(lray > -1)
-                    {
-                        g.voxels[lray] = 0;
-                        if(mirror == 1)
-                        {
-                            const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                            g.voxels[PTI(x, ghp.y, ghp.z)] = 0;
-                        }
-                        has_changed = 1;
-                    }
+                    strokeBegin(BRUSH_DELETE);
                 }
                 else if(event.key.keysym.sym == SDLK_q || event.key.keysym.sym == SDLK_z) // clone pointed voxel color
                 {
@@ -305,23 +288,13 @@ void main_loop()
                 }
                 else if(event.key.keysym.sym == SDLK_e) // replace pointed voxel
                 {
-                    rtt = t+rrsp;
-                    traceViewPath(0);
-                    if(lray > -1)
-                    {
-                        g.voxels[lray] = g.st;
-                        if(mirror == 1)
-                        {
-                            const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                            g.voxels[PTI(x, ghp.y, ghp.z)] = g.st;
-                        }
-                        has_changed = 1;
-                    }
-                }
-                else if(event.key.keysym.sym == SDLK_r) // toggle mirror brush
-                {
-                    mirror = 1 - mirror;
+                    strokeBegin(BRUSH_PAINT);
                 }
+                else if(event.key.keysym.sym == SDLK_r){symToggle(SYM_X);} // toggle mirror brush
+                else if(event.key.keysym.sym == SDLK_8){symToggle(SYM_Y);}
+                else if(event.key.keysym.sym == SDLK_9){symToggle(SYM_Z);}
+                else if(event.key.keysym.sym == SDLK_0){symFold();} // radial copies around z
+                else if(event.key.keysym.sym == SDLK_o){symCentre(regionPoint());} // move the symmetry planes
                 else if(event.key.keysym.sym == SDLK_v) // place voxel at current position
                 {
                     vec p = g.pp;
@@ -332,10 +305,46 @@ void main_loop()
                     const vec rp = (vec){roundf(p.x), roundf(p.y), roundf(p.z)};
                     if(isInBounds(rp) == 1)
                     {
-                        g.voxels[PTI(rp.x, rp.y, rp.z)] = 8;
-                        has_changed = 1;
+                        prof_count.edits += editVoxel(&g, PTI(rp.x, rp.y, rp.z), 8);
+                    }
+                }
+                else if(event.key.keysym.sym == SDLK_b){regionPick();} // pick a box corner
+                else if(event.key.keysym.sym == SDLK_g){regionEdit(REGION_FILL);}
+                else if(event.key.keysym.sym == SDLK_h){regionEdit(REGION_CLEAR);}
+                else if(event.key.keysym.sym == SDLK_j){regionEdit(REGION_REPAINT);}
+                else if(event.key.keysym.sym == SDLK_k){regionEdit(REGION_REPLACE);}
+                else if(event.key.keysym.sym == SDLK_t){floodEdit();} // flood fill from the pointed voxel
+                else if(event.key.keysym.sym == SDLK_y){floodMode();}
+                else if(event.key.keysym.sym == SDLK_n){clipEdit();} // copy the box
+                else if(event.key.keysym.sym == SDLK_m) // paste it, repeats while held
+                {
+                    if(event.key.repeat == 0)
+                    {
+                        ctt = t+rrsp;
+                        clipStamp(0);
                     }
                 }
+                else if(event.key.keysym.sym == SDLK_COMMA){clipTurn(0);}
+                else if(event.key.keysym.sym == SDLK_LEFTBRACKET){brushSet(brush_shape, brush_size-1);} // brush size
+                else if(event.key.keysym.sym == SDLK_RIGHTBRACKET){brushSet(brush_shape, brush_size+1);}
+                else if(event.key.keysym.sym == SDLK_l){brushSet(brush_shape+1, brush_size);} // brush shape
+                else if(event.key.keysym.sym == SDLK_F5){xformEdit(XFORM_ROTATE, XFORM_X, 0);} // turn the whole volume
+                else if(event.key.keysym.sym == SDLK_F6){xformEdit(XFORM_ROTATE, XFORM_Y, 0);}
+                else if(event.key.keysym.sym == SDLK_F7){xformEdit(XFORM_ROTATE, XFORM_Z, 0);}
+                else if(event.key.keysym.sym == SDLK_SEMICOLON){xformEdit(XFORM_FLIP, 0, 0);} // along the axis faced
+                else if(event.key.keysym.sym == SDLK_MINUS){xformEdit(XFORM_SHIFT, 0, -1);}
+                else if(event.key.keysym.sym == SDLK_EQUALS){xformEdit(XFORM_SHIFT, 0, 1);}
+                else if(event.key.keysym.sym == SDLK_F10){hollowEdit(0);} // strip the interior
+                else if(event.key.keysym.sym == SDLK_F11){hollowEdit(1);} // fill it back in
+                else if(event.key.keysym.sym == SDLK_PERIOD){clipTurn(1);}
+                else if(event.key.keysym.sym == SDLK_u || event.key.keysym.sym == SDLK_i) // undo, redo
+                {
+                    const uint u = event.key.keysym.sym == SDLK_u;
+                    const uint n = u == 1 ? undo() : redo();
+                    if(n == 0){sprintf(warnm, "Nothing to %s.", u == 1 ? "undo" : "redo");}
+                    else{sprintf(warnm, "%s %u voxels.", u == 1 ? "Undo" : "Redo", n);}
+                    wti = t+1.f;
+                }
                 else if(event.key.keysym.sym == SDLK_f) // toggle movement speeds
                 {
                     fks = 1 - fks;
@@ -388,9 +397,32 @@ void main_loop()
                 {
                     saveState(openTitle, "", load_state);
                 }
+                else if(event.key.keysym.sym == SDLK_F4) // toggle the stats overlay
+                {
+                    prof_stats = 1 - prof_stats;
+                    profSample();
+                }
                 else if(event.key.keysym.sym == SDLK_F8)
                 {
                     loadState(openTitle, 0);
+                    undoReset();
+                }
+                else if(event.key.keysym.sym == SDLK_F9) // start recording a trace, press again to save it
+                {
+                    char tmp[16];
+                    timestamp(tmp);
+                    if(prof_on == 0)
+                    {
+                        profStart();
+                        printf("[%s] Recording trace, press F9 again to save it.\n", tmp);
+                    }
+                    else
+                    {
+                        profStop();
+                        char file[1024];
+                        sprintf(file, "%s%s.trace.json", appdir, openTitle);
+                        if(profDump(file) == 1){printf("[%s] Saved trace: %s\n", tmp, file);}
+                    }
                 }
                 else if(event.key.keysym.sym == SDLK_p)
                 {
@@ -413,9 +445,10 @@ void main_loop()
                 else if(event.key.keysym.sym == SDLK_UP){ks[7] = 0;}
                 else if(event.key.keysym.sym == SDLK_DOWN){ks[8] = 0;}
                 else if(event.key.keysym.sym == SDLK_SPACE){ks[9] = 0;}
-                else if(event.key.keysym.sym == SDLK_RSHIFT){ptt = 0.f;}
-                else if(event.key.keysym.sym == SDLK_RCTRL){dtt = 0.f;}
-                else if(event.key.keysym.sym == SDLK_e){rtt = 0.f;}
+                else if(event.key.keysym.sym == SDLK_RSHIFT){strokeEnd(BRUSH_PLACE);}
+                else if(event.key.keysym.sym == SDLK_RCTRL){strokeEnd(BRUSH_DELETE);}
+                else if(event.key.keysym.sym == SDLK_e){strokeEnd(BRUSH_PAINT);}
+                else if(event.key.keysym.sym == SDLK_m){ctt = 0.f;}
                 idle = t;
             }
             break;
@@ -455,6 +488,7 @@ void main_loop()
                 my = event.motion.y;
 
                 if(focus_mouse == 0){break;}
+                strokeMotion(&event.motion, lx, ly);
                 idle = t;
             }
             break;
@@ -470,10 +504,10 @@ void main_loop()
                         WOX_POP(winw, winh);
                         SDL_CaptureMouse(SDL_FALSE);
                     }
-                    ptt = 0.f;
+                    strokeEnd(BRUSH_PLACE);
                 }
-                else if(event.button.button == SDL_BUTTON_RIGHT){dtt = 0.f;}
-                else if(event.button.button == SDL_BUTTON_X2){rtt = 0.f;}
+                else if(event.button.button == SDL_BUTTON_RIGHT){strokeEnd(BRUSH_DELETE);}
+                else if(event.button.button == SDL_BUTTON_X2){strokeEnd(BRUSH_PAINT);}
                 idle = t;
             }
             break;
@@ -579,36 +613,11 @@ void main_loop()
 
                 if(event.button.button == SDL_BUTTON_LEFT) // place a voxel
                 {
-                    ptt = t+rrsp;
-                    traceViewPath(1);
-                    if(lray > -1)
-                    {
-                        if(g.pb.w == 1 && isInBounds(g.pb) && g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] == 0)
-                        {
-                            g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] = g.st;
-                            if(mirror == 1)
-                            {
-                                const float x = g.pb.x > 64.f ? 64.f+(64.f-g.pb.x) : 64.f + (64.f-g.pb.x);
-                                g.voxels[PTI(x, g.pb.y, g.pb.z)] = g.st;
-                            }
-                            has_changed = 1;
-                        }
-                    }
+                    strokeBegin(BRUSH_PLACE);
                 }
                 else if(event.button.button == SDL_BUTTON_RIGHT) // remove pointed voxel
                 {
-                    dtt = t+rrsp;
-                    traceViewPath(0);
-                    if(lray > -1)
-                    {
-                        g.voxels[lray] = 0;
-                        if(mirror == 1)
-                        {
-                            const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                            g.voxels[PTI(x, ghp.y, ghp.z)] = 0;
-                        }
-                        has_changed = 1;
-                    }
+                    strokeBegin(BRUSH_DELETE);
                 }
                 else if(event.button.button == SDL_BUTTON_MIDDLE || event.button.button == SDL_BUTTON_X1) // clone pointed voxel
                 {
@@ -625,18 +634,7 @@ void main_loop()
                 }
                 else if(event.button.button == SDL_BUTTON_X2) // replace pointed node
                 {
-                    rtt = t+rrsp;
-                    traceViewPath(0);
-                    if(lray > -1)
-                    {
-                        g.voxels[lray] = g.st;
-                        if(mirror == 1)
-                        {
-                            const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                            g.voxels[PTI(x, ghp.y, ghp.z)] = g.st;
-                        }
-                        has_changed = 1;
-                    }
+                    strokeBegin(BRUSH_PAINT);
                 }
                 idle = t;
             }
@@ -661,54 +659,10 @@ void main_loop()
             vNorm(&look_dir);
         }
 
-        if(ptt != 0.f && t > ptt) // place trigger
+        if(ctt != 0.f && t > ctt) // paste trigger
         {
-            traceViewPath(1);
-            if(lray > -1)
-            {
-                if(g.pb.w == 1 && isInBounds(g.pb) && g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] == 0)
-                {
-                    g.voxels[PTI(g.pb.x, g.pb.y, g.pb.z)] = g.st;
-                    if(mirror == 1)
-                    {
-                        const float x = g.pb.x > 64.f ? 64.f+(64.f-g.pb.x) : 64.f + (64.f-g.pb.x);
-                        g.voxels[PTI(x, g.pb.y, g.pb.z)] = g.st;
-                    }
-                    has_changed = 1;
-                }
-            }
-            ptt = t+0.1;
-        }
-
-        if(dtt != 0.f && t > dtt) // delete trigger
-        {
-            traceViewPath(0);
-            if(lray > -1)
-            {
-                g.voxels[lray] = 0;
-                if(mirror == 1)
-                {
-                    const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                    g.voxels[PTI(x, ghp.y, ghp.z)] = 0;
-                }
-                has_changed = 1;
-            }
-            dtt = t+0.1f;
-        }
-
-        if(rtt != 0.f) // replace trigger
-        {
-            traceViewPath(0);
-            if(lray > -1)
-            {
-                g.voxels[lray] = g.st;
-                if(mirror == 1)
-                {
-                    const float x = ghp.x > 64.f ? 64.f+(64.f-ghp.x) : 64.f + (64.f-ghp.x);
-                    g.voxels[PTI(x, ghp.y, ghp.z)] = g.st;
-                }
-                has_changed = 1;
-            }
+            clipStamp(1);
+            ctt = t+0.1f;
         }
 
         if(ks[0] == 1) // W
@@ -835,6 +789,13 @@ void main_loop()
     mRotate(&view, g.xrot, 0.f, 0.f, 1.f);
 
     mGetViewZ(&look_dir, view); // refresh
+    strokeFrame(); // walking or the arrow keys moved a held stroke
+
+    // this frame's edits go to the upload and the undo record together,
+    // an action ends when nothing is held, a click or a whole stroke undoes as one
+    editFlush();
+    if(stroke_op < 0 && ctt == 0.f){undoCommit();}
+    PROF_END(PROF_INPUT);
 
 //*************************************
 // begin render
@@ -853,8 +814,13 @@ void main_loop()
         static float nt = 0.f;
         if(t > nt)
         {
+            PROF_BEGIN(PROF_HUD);
             drawHud(focus_mouse);
+            PROF_END(PROF_HUD);
+            PROF_BEGIN(PROF_FLIPHUD);
             flipHud();
+            prof_count.bytes += sHud->w*sHud->h*4;
+            PROF_END(PROF_FLIPHUD);
             nt = t+0.1f; // limit hud to 10fps
         }
     }
@@ -862,19 +828,12 @@ void main_loop()
     // has changed?
     if(has_changed == 1)
     {
+        PROF_BEGIN(PROF_TEXTURE);
+
         // update voxels
-        for (int x = 0; x < 1024; x++)
-        for (int y = 0; y < 2048; y++) {
-            int index = (x * 2048) + y;
-            if (g.voxels[index] < 1) {
-            setpixel(sVoxel, x, y, 0x00000000);
-            } else {
-                uint32_t color = g.colors[g.voxels[index]-1];
-                color = (color >> 16) | (((color >> 8) & 0xFF) << 8) | ((color & 0xFF) << 16) | (0xFF << 24);
-                setpixel(sVoxel, x, y, color);
-            }
-        }
+        updateVoxelSurface();
         voxelmap = esReLoadTextureA(1024, 2048, sVoxel->pixels, 0);
+        prof_count.bytes += 1024*2048*4;
 
         // bind the new texture
         glActiveTexture(GL_TEXTURE0);
@@ -888,9 +847,19 @@ void main_loop()
 
 		// reset
 		has_changed = 0;
+        dirty_nboxes = 0;
+        PROF_END(PROF_TEXTURE);
+    }
+    else if(dirty_nboxes > 0) // only a few boxes changed
+    {
+        PROF_BEGIN(PROF_TEXTURE);
+        prof_count.bytes += updateVoxelRegion(voxelmap);
+        glActiveTexture(GL_TEXTURE1); // flipHud() expects the hud unit
+        PROF_END(PROF_TEXTURE);
     }
 
     // pass the current look pos (player position)
+    PROF_BEGIN(PROF_DRAW);
     glUniform3f(look_pos_id, -g.pp.x, -g.pp.y, -g.pp.z);
 
     // pass the view unit vectors
@@ -911,12 +880,20 @@ void main_loop()
     glUniform3fv(view_id + 2, 1, (GLfloat*)&v);
 
     // ok let's draw
+    gpuBegin();
     glDrawElements(GL_TRIANGLES, hud_numind, GL_UNSIGNED_BYTE, 0);
+    gpuEnd();
+    latSubmit();
+    PROF_END(PROF_DRAW);
 
 //*************************************
 // swap buffers / display render
 //*************************************
+    PROF_BEGIN(PROF_SWAP);
     SDL_GL_SwapWindow(wnd);
+    latSwap();
+    PROF_END(PROF_SWAP);
+    PROF_END(PROF_FRAME);
 }
 void drawHud(const uint type)
 {    
@@ -975,25 +952,27 @@ void drawHud(const uint type)
             SDL_FillRect(sHud, &(SDL_Rect){winw2+30, 3, winw2-72, 13}, 0xDDa0b010);
 
             // fps
-            char tmp[16];
-            sprintf(tmp, "%u", g_fps);
+            char tmp[64];
+            if(gpu_mode == GPU_OFF){sprintf(tmp, "%u", g_fps);}
+            else{sprintf(tmp, "%u  gpu %.2f ms", g_fps, g_gpums);}
             SDL_FillRect(sHud, &(SDL_Rect){0, 19, lenText(tmp)+8, 19}, 0xCC000000);
             drawText(sHud, tmp, 4, 23, 2);
         }
         else
         {
             // fps
-            char tmp[16];
-            sprintf(tmp, "%u", g_fps);
+            char tmp[64];
+            if(gpu_mode == GPU_OFF){sprintf(tmp, "%u", g_fps);}
+            else{sprintf(tmp, "%u  gpu %.2f ms", g_fps, g_gpums);}
             SDL_FillRect(sHud, &(SDL_Rect){0, 0, lenText(tmp)+8, 19}, 0xCC000000);
             drawText(sHud, tmp, 4, 4, 2);
         }
 
         // center hud
         const int left = winw2-177;
-        int top = winh2-152;
-        SDL_FillRect(sHud, &(SDL_Rect){winw2-193, top-3, 382, 303}, 0x33FFFFFF);
-        SDL_FillRect(sHud, &(SDL_Rect){winw2-190, top, 376, 297}, 0xCC000000);
+        int top = winh2-179; // centred, fits the smallest window the resize allows
+        SDL_FillRect(sHud, &(SDL_Rect){winw2-193, top-3, 382, 364}, 0x33FFFFFF);
+        SDL_FillRect(sHud, &(SDL_Rect){winw2-190, top, 376, 358}, 0xCC000000);
         int a = drawText(sHud, "Woxel", winw2-15, top+11, 3);
         a = drawText(sHud, appVersion, left+330, top+11, 4);
         a = drawText(sHud, "woxels.github.io", left, top+11, 4);
@@ -1040,6 +1019,14 @@ void drawHud(const uint type)
         a = drawText(sHud, " V ", a, top, 2);
         drawText(sHud, "Place node at current location.", a, top, 1);
 
+        top += 11;
+        a = drawText(sHud, "8 9 ", left, top, 2);
+        a = drawText(sHud, "Mirror Y Z. ", a, top, 1);
+        a = drawText(sHud, "0 ", a, top, 2);
+        a = drawText(sHud, "Radial copies. ", a, top, 1);
+        a = drawText(sHud, "O ", a, top, 2);
+        drawText(sHud, "Move symmetry to pointed node.", a, top, 1);
+
         top += 11;
         a = drawText(sHud, "Middle Scroll ", left, top, 2);
         drawText(sHud, "Change selected color.", a, top, 1);
@@ -1050,6 +1037,52 @@ void drawHud(const uint type)
         a = drawText(sHud, "C ", a, top, 2);
         drawText(sHud, "Scroll color of pointed node.", a, top, 1);
 
+        top += 11;
+        a = drawText(sHud, "B ", left, top, 2);
+        a = drawText(sHud, "Pick box corners. ", a, top, 1);
+        a = drawText(sHud, "G H J K ", a, top, 2);
+        drawText(sHud, "Fill clear repaint or replace box.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "T ", left, top, 2);
+        a = drawText(sHud, "Flood fill from pointed node.", a, top, 1);
+        a = drawText(sHud, " Y ", a, top, 2);
+        drawText(sHud, "Flood fill mode.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "U ", left, top, 2);
+        a = drawText(sHud, "Undo. ", a, top, 1);
+        a = drawText(sHud, "I ", a, top, 2);
+        drawText(sHud, "Redo.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "N ", left, top, 2);
+        a = drawText(sHud, "Copy box. ", a, top, 1);
+        a = drawText(sHud, "M ", a, top, 2);
+        a = drawText(sHud, "Paste. ", a, top, 1);
+        a = drawText(sHud, "Comma Period ", a, top, 2);
+        drawText(sHud, "Turn or mirror.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "Brackets ", left, top, 2);
+        a = drawText(sHud, "Brush size. ", a, top, 1);
+        a = drawText(sHud, "L ", a, top, 2);
+        drawText(sHud, "Brush shape cube sphere or cylinder.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "F5 F6 F7 ", left, top, 2);
+        a = drawText(sHud, "Turn all. ", a, top, 1);
+        a = drawText(sHud, "Semicolon ", a, top, 2);
+        a = drawText(sHud, "Flip. ", a, top, 1);
+        a = drawText(sHud, "Minus Equals ", a, top, 2);
+        drawText(sHud, "Shift.", a, top, 1);
+
+        top += 11;
+        a = drawText(sHud, "F10 ", left, top, 2);
+        a = drawText(sHud, "Hollow to brush radius. ", a, top, 1);
+        a = drawText(sHud, "F11 ", a, top, 2);
+        drawText(sHud, "Solidify enclosed space.", a, top, 1);
+
         top += 22;
         a = drawText(sHud, "F1 ", left, top, 2);
         drawText(sHud, "Resets environment state back to default.", a, top, 1);
@@ -1066,6 +1099,12 @@ void drawHud(const uint type)
         a = drawText(sHud, "F8 ", left, top, 2);
         drawText(sHud, "Load. Will erase what you have done since the last save.", a, top, 1);
 
+        top += 11;
+        a = drawText(sHud, "F4 ", left, top, 2);
+        a = drawText(sHud, "Performance stats overlay. ", a, top, 1);
+        a = drawText(sHud, "F9 ", a, top, 2);
+        drawText(sHud, "Start or stop a trace.", a, top, 1);
+
         top += 22;
         drawText(sHud, "Check the console output for more information.", left, top, 3);
 
@@ -1168,7 +1207,7 @@ void drawHud(const uint type)
                 setpixel(sHud, winw2-5, winh2, sclr);
             }
 
-            if(mirror == 1)
+            if(symOn() == 1)
             {
                 setpixel(sHud, winw2+2, winh2+2, sclr);
                 setpixel(sHud, winw2-2, winh2-2, sclr);
@@ -1236,6 +1275,18 @@ void drawHud(const uint type)
         }
     }
 
+    // box
+    if(type == 1 && showhud == 1 && region_corners > 0)
+    {
+        char tmp[128];
+        if(region_corners == 1){sprintf(tmp, "box %u %u %u  B for the other corner", region.x0, region.y0, region.z0);}
+        else{sprintf(tmp, "box %u %u %u to %u %u %u  %ux%ux%u  %u voxels", region.x0, region.y0, region.z0, region.x1, region.y1, region.z1,
+            region.x1-region.x0+1, region.y1-region.y0+1, region.z1-region.z0+1, regionVolume(&region));}
+        const int hlen = lenText(tmp)/2;
+        SDL_FillRect(sHud, &(SDL_Rect){winw2-hlen-4, 57, hlen*2+8, 15}, 0xCC000000);
+        drawText(sHud, tmp, winw2-hlen, 59, 3);
+    }
+
     // tooltips
     if(wti > t)
     {
@@ -1243,8 +1294,88 @@ void drawHud(const uint type)
         drawText(sHud, warnm, winw2-hlen, winh2-22, 3);
     }
 
+    // stats overlay
+    if(prof_stats == 1){drawStats();}
+
     // flip the new hud to gpu
     flipHud();
+    prof_count.bytes += sHud->w*sHud->h*4;
+}
+void drawStats()
+{
+    // sample once a second, the hud only redraws at 10fps anyway
+    static float nt = 0.f;
+    static uint voxels = 0;
+    static Uint64 rss = 0;
+    if(t > nt)
+    {
+        profSample();
+        voxels = placedVoxels();
+        rss = profResident();
+        nt = t+1.f;
+    }
+
+    const int left = 4;
+    int top = winh-174;
+    SDL_FillRect(sHud, &(SDL_Rect){0, top-4, 2*PROF_GRAPH+8, 174}, 0xCC000000);
+
+    // frame time graph, 1.5px per ms, lines at 60 and 30 fps
+    const int gb = top+50;
+    for(uint i = 0; i < PROF_GRAPH; i++)
+    {
+        const float ms = prof_graph[(prof_graph_head+i) & (PROF_GRAPH-1)];
+        int h = (int)(ms*1.5f);
+        if(h > 50){h = 50;}
+        if(h < 1){continue;}
+        SDL_FillRect(sHud, &(SDL_Rect){left+i*2, gb-h, 2, h}, ms > 33.4f ? 0xFF0045FF : ms > 16.7f ? 0xFF00BFFF : 0xFF97C920);
+    }
+    SDL_FillRect(sHud, &(SDL_Rect){left, gb-25, 2*PROF_GRAPH, 1}, 0x66FFFFFF);
+    SDL_FillRect(sHud, &(SDL_Rect){left, gb-50, 2*PROF_GRAPH, 1}, 0x66FFFFFF);
+
+    char tmp[256];
+    top = gb+4;
+    if(gpu_mode == GPU_OFF){sprintf(tmp, "%.1f fps  %.2f ms", prof_rate.fps, prof_rate.ms[PROF_FRAME]);}
+    else{sprintf(tmp, "%.1f fps  %.2f ms  gpu %.2f ms", prof_rate.fps, prof_rate.ms[PROF_FRAME], prof_rate.gpu);}
+    drawText(sHud, tmp, left, top, 2);
+
+    top += 11;
+    sprintf(tmp, "input %.2f  trace %.2f  hud %.2f  flip %.2f", prof_rate.ms[PROF_INPUT], prof_rate.ms[PROF_TRACE], prof_rate.ms[PROF_HUD], prof_rate.ms[PROF_FLIPHUD]);
+    drawText(sHud, tmp, left, top, 1);
+
+    top += 11;
+    sprintf(tmp, "texture %.2f  draw %.2f  swap %.2f", prof_rate.ms[PROF_TEXTURE], prof_rate.ms[PROF_DRAW], prof_rate.ms[PROF_SWAP]);
+    drawText(sHud, tmp, left, top, 1);
+
+    // input to photon, as near as the swap gets us
+    top += 11;
+    sprintf(tmp, "input to submit %.1f  p95 %.1f  max %.1f ms", lat_rate[LAT_SUBMIT].p50, lat_rate[LAT_SUBMIT].p95, lat_rate[LAT_SUBMIT].max);
+    drawText(sHud, tmp, left, top, 3);
+    top += 11;
+    sprintf(tmp, "input to swap %.1f  p95 %.1f  max %.1f ms", lat_rate[LAT_SWAP].p50, lat_rate[LAT_SWAP].p95, lat_rate[LAT_SWAP].max);
+    drawText(sHud, tmp, left, top, 3);
+
+    top += 11;
+    sprintf(tmp, "upload %.1f MB per sec", prof_rate.bytes / 1048576.f);
+    drawText(sHud, tmp, left, top, 1);
+
+    top += 11;
+    sprintf(tmp, "rays %.0f  steps %.0f per sec", prof_rate.rays, prof_rate.steps);
+    drawText(sHud, tmp, left, top, 1);
+
+    top += 11;
+    sprintf(tmp, "edits %.0f per sec  voxels %u", prof_rate.edits, voxels);
+    drawText(sHud, tmp, left, top, 1);
+
+    top += 11;
+    const region_box* b = &journal_aabb;
+    if(edit_unsaved == 1){sprintf(tmp, "unsaved %ux%ux%u at %u,%u,%u", b->x1-b->x0+1, b->y1-b->y0+1, b->z1-b->z0+1, b->x0, b->y0, b->z0);}
+    else{sprintf(tmp, "no unsaved edits");}
+    drawText(sHud, tmp, left, top, 1);
+
+    top += 11;
+    if(rss != 0){sprintf(tmp, "memory %.1f MB", (double)rss / 1048576.0);}
+    else{sprintf(tmp, "memory n/a");}
+    drawText(sHud, tmp, left, top, 1);
 }
 
 //*************************************
@@ -1255,6 +1386,11 @@ int main(int argc, char** argv)
 //*************************************
 // init stuff
 //*************************************
+    // exporting to stdout? then the console output goes to stderr
+    if(argc >= 5 && (strcmp(argv[1], "export") == 0 || strcmp(argv[1], "lod") == 0)){exportRedirect(argv[4]);}
+    if(argc >= 4 && (strcmp(argv[1], "preview") == 0 || strcmp(argv[1], "render") == 0 || strcmp(argv[1], "bench") == 0)){exportRedirect(argv[3]);}
+    if(argc >= 4 && strcmp(argv[1], "microbench") == 0){exportRedirect(argv[3]);}
+
     printf("██╗    ██╗ ██████╗ ██╗  ██╗███████╗██╗     \n");
     printf("██║    ██║██╔═══██╗╚██╗██╔╝██╔════╝██║     \n");
     printf("██║ █╗ ██║██║   ██║ ╚███╔╝ █████╗  ██║     \n");
@@ -1265,20 +1401,23 @@ int main(int argc, char** argv)
     printf("Input Mapping:\n");
     printf("W,A,S,D = Move around based on relative orientation to X and Y.\n");
     printf("SPACE + L-SHIFT = Move up and down relative Z.\n");
-    printf("Left Click / R-SHIFT = Place node.\n");
-    printf("Right Click / R-CTRL = Delete node.\n");
+    printf("Left Click / R-SHIFT = Place node, hold and sweep to draw a stroke.\n");
+    printf("Right Click / R-CTRL = Delete node, hold and sweep to carve a stroke.\n");
     printf("V = Places voxel at current position.\n");
     printf("Q / Z / Middle Click / Mouse4 = Clone color of pointed node.\n");
-    printf("E / Mouse5 = Replace color of pointed node.\n");
+    printf("E / Mouse5 = Replace color of pointed node, hold and sweep to paint a stroke.\n");
     printf("F = Toggle player fast speed on and off.\n");
     printf("1-7 = Change move speed for selected fast state.\n");
     printf("X + C / Slash + Quote = Scroll color of pointed node.\n");
     printf("R = Toggle mirror brush.\n");
+    printf("8 / 9 = Toggle Y / Z mirror, 0 = Change radial copies around Z, O = Move symmetry to pointed node.\n");
     printf("P = Toggle pitch lock.\n");
     printf("F1 = Resets environment state back to default.\n");
     printf("F2 = Toggle HUD visibility.\n");
     printf("F3 = Save. (auto saves on exit, backup made if idle for 3 mins)\n");
+    printf("F4 = Toggle the performance stats overlay.\n");
     printf("F8 = Load. (will erase what you have done since the last save)\n");
+    printf("F9 = Start recording a performance trace, press again to save it.\n");
     printf("\n* Arrow Keys can be used to move the view around.\n");
     printf("* Your state is automatically saved on exit.\n");
     printf("\nConsole Arguments:\n");
@@ -1290,14 +1429,43 @@ int main(int argc, char** argv)
     printf("color on each new line, 32 colors maximum. e.g; \"#00FFFF\".\n\n");
     printf("To load from file: ./wox loadgz <file_path>\n");
     printf("e.g; ./wox loadgz /home/user/file.wox.gz\n\n");
-    printf("To export: ./wox export <project_name> <option: wox,txt,vv,ply> <export_path>\n");
+    printf("To export: ./wox export <project_name> <option: wox,txt,vv,ply,glb> <export_path>\n");
     printf("e.g; ./wox export txt /home/user/file.txt\n");
+    printf("glb is binary glTF with a palette texture, ready to drop into game engines.\n");
+    printf("An export_path of - writes to stdout, -<fd> writes to an open file descriptor.\n");
+    printf("e.g; ./wox export Untitled ply - | gzip > /home/user/file.ply.gz\n");
     printf("When exporting as ply you will want to merge vertices by distance in Blender\nor `Cleaning and Repairing > Merge Close Vertices` in MeshLab.\n\n");
+    printf("To export a level of detail chain: ./wox lod <project_name> <option> <export_path> <levels> <threshold>\n");
+    printf("e.g; ./wox lod Untitled glb /home/user/file.glb 4 4\n");
+    printf("Each level halves the grid, a 2x2x2 block is kept when <threshold> of its 8 voxels are set.\n\n");
+    printf("To batch export: ./wox batch [-j<threads>] <formats> <output_dir> <project|file.wox.gz|'glob'|@manifest> ...\n");
+    printf("e.g; ./wox batch ply,vv /tmp/out '/home/user/models/*.wox.gz'\n\n");
+    printf("To render a preview on the CPU: ./wox preview <project|file.wox.gz> <image.png|image.ppm> <width> <height> <yaw> <elevation> <radius>\n");
+    printf("e.g; ./wox preview Untitled /tmp/thumb.png 512 512 45 30 240\n");
+    printf("To render with the GPU shader and no window: ./wox render <project|file.wox.gz> <image.png|image.ppm> <width> <height> <yaw> <elevation> <radius>\n");
+    printf("Without yaw, elevation and radius the camera saved with the project is used.\n\n");
+    printf("To render views around a model: ./wox turntable <project|file.wox.gz> <prefix.png|prefix.ppm> <views> <width> <height> <elevation> <radius>\n");
+    printf("e.g; ./wox turntable Untitled /tmp/views/shot.png 16 1024 1024 30 240\n\n");
+    printf("To benchmark the renderer: ./wox bench <project|file.wox.gz> <json_path> <frames> <WxH,WxH,...>\n");
+    printf("e.g; ./wox bench Untitled /tmp/bench.json 240 640x360,1280x720,1920x1080\n");
+    printf("Flies a fixed camera path with vsync off, use LIBGL_ALWAYS_SOFTWARE=1 to bench Mesa llvmpipe.\n\n");
+    printf("To time the CPU hot paths on synthetic volumes: ./wox microbench <reps> <json_path>\n");
+    printf("e.g; ./wox microbench 15 /tmp/micro.json\n\n");
+    printf("To check the GPU renderer against golden images: ./wox regress [-u] [-t<tolerance>] [-p<pixels>] <golden_dir> <[OPTIONAL]project|file.wox.gz> ...\n");
+    printf("e.g; ./wox regress /tmp/golden Untitled\n");
+    printf("A missing or unreadable golden fails, -u writes them all after an intended change.\n\n");
+    printf("To turn, flip or shift a saved project: ./wox transform [-o<file.wox.gz>] <project|file.wox.gz> <op> ...\n");
+    printf("e.g; ./wox transform Untitled rotz flipx shift:0,0,-4 wrap:64,0,0\n");
+    printf("hollow:<shell> removes voxels deeper than the shell, solidify fills enclosed space.\n");
+    printf("Without -o the project is overwritten.\n\n");
     printf("Find more color palettes at; https://lospec.com/palette-list\n");
     printf("You can use any palette upto 32 colors. But don't use #000000 (Black)\nin your color palette as it will terminate at that color.\n\n");
     printf("Default 32 Color Palette: https://lospec.com/palette-list/resurrect-32\n");
     printf("\n----\n");
 
+    // WOX_TRACE=<file.json> profiles the whole run
+    profInit();
+
     // seed random
     srand(time(0));
     srandf(time(0));
@@ -1306,9 +1474,26 @@ int main(int argc, char** argv)
     basedir = SDL_GetBasePath();
     appdir = SDL_GetPrefPath("voxdsp", "woxel");
 
+    // batch export and quit
+    if(argc >= 2 && strcmp(argv[1], "batch") == 0){return batchExport(argc, argv);}
+
+    // time the cpu hot paths and quit
+    if(argc >= 2 && strcmp(argv[1], "microbench") == 0){return microBench(argc, argv);}
+
+    // compare gpu renders against golden images and quit
+    if(argc >= 2 && strcmp(argv[1], "regress") == 0){return regressRun(argc, argv);}
+
+    // turn, flip or shift a saved project and quit
+    if(argc >= 2 && strcmp(argv[1], "transform") == 0){return transformRun(argc, argv);}
+
     // argv
     char export_path[1024] = {0};
     uint export_type = 0;
+    uint lod_levels = 0, lod_threshold = 4;
+    char preview_path[1024] = {0};
+    uint headless = 0;
+    char turntable_path[1024] = {0};
+    uint bench = 0;
     if(argc >= 2 && strlen(argv[1]) < 256)
     {
         sprintf(openTitle, "%s", argv[1]);
@@ -1321,10 +1506,41 @@ int main(int argc, char** argv)
     if(argc >= 5 && strcmp(argv[1], "export") == 0 && strlen(argv[2]) < 256 && strlen(argv[4]) < 1024)
     {
         sprintf(openTitle, "%s", argv[2]);
-        if     (strcmp(argv[3], "txt") == 0){export_type=1;}
-        else if(strcmp(argv[3], "vv") == 0){export_type=2;}
-        else if(strcmp(argv[3], "ply") == 0){export_type=3;}
+        const int type = exportType(argv[3]);
+        if(type > 0){export_type = type;}
+        sprintf(export_path, "%s", argv[4]);
+    }
+    if(argc >= 5 && strcmp(argv[1], "lod") == 0 && strlen(argv[2]) < 256 && strlen(argv[4]) < 1024)
+    {
+        sprintf(openTitle, "%s", argv[2]);
+        const int type = exportType(argv[3]);
+        if(type > 0){export_type = type;}
         sprintf(export_path, "%s", argv[4]);
+        lod_levels = 4;
+        if(argc >= 6){lod_levels = atoi(argv[5]);}
+        if(argc >= 7){lod_threshold = atoi(argv[6]);}
+    }
+    if(argc >= 4 && (strcmp(argv[1], "preview") == 0 || strcmp(argv[1], "render") == 0) && strlen(argv[2]) < 256 && strlen(argv[3]) < 1024)
+    {
+        sprintf(openTitle, "%s", argv[2]);
+        const size_t len = strlen(argv[2]);
+        load_state = strchr(argv[2], '/') != NULL || (len > 7 && strcmp(argv[2]+len-7, ".wox.gz") == 0);
+        sprintf(preview_path, "%s", argv[3]);
+        headless = strcmp(argv[1], "render") == 0;
+    }
+    if(argc >= 4 && strcmp(argv[1], "turntable") == 0 && strlen(argv[2]) < 256 && strlen(argv[3]) < 1000)
+    {
+        sprintf(openTitle, "%s", argv[2]);
+        const size_t len = strlen(argv[2]);
+        load_state = strchr(argv[2], '/') != NULL || (len > 7 && strcmp(argv[2]+len-7, ".wox.gz") == 0);
+        sprintf(turntable_path, "%s", argv[3]);
+    }
+    if(argc >= 3 && strcmp(argv[1], "bench") == 0 && strlen(argv[2]) < 256)
+    {
+        sprintf(openTitle, "%s", argv[2]);
+        const size_t len = strlen(argv[2]);
+        load_state = strchr(argv[2], '/') != NULL || (len > 7 && strcmp(argv[2]+len-7, ".wox.gz") == 0);
+        bench = 1;
     }
 
     // default state
@@ -1412,181 +1628,74 @@ int main(int argc, char** argv)
 
     //memset(&g.voxels, 8, max_voxels);
 
+    // if this is just a preview render then render and quit.
+    if(preview_path[0] != 0x00)
+    {
+        const uint w = argc >= 5 ? atoi(argv[4]) : 512;
+        const uint h = argc >= 6 ? atoi(argv[5]) : w;
+        if(w < 1 || h < 1 || w > 16384 || h > 16384){printf("ERROR: bad preview size %ux%u.\n", w, h); return 1;}
+        render_camera c;
+        if(argc >= 9){cameraOrbit(&c, atof(argv[6]), atof(argv[7]), atof(argv[8]), w, h);}
+        else{cameraState(&c, &g, w, h);}
+        if(headless == 1){return headlessRender(preview_path, w, h, &c);} // same shader as the editor, no window
+        uchar* px = malloc((size_t)w*h*3);
+        if(px == NULL){return 1;}
+#ifdef __linux__
+        const uint64_t st = microtime();
+#endif
+        renderImage(px, &g, &c, w, h, 0);
+        char tmp[16];
+        timestamp(tmp);
+#ifndef __linux__
+        printf("[%s] Rendered %ux%u preview.\n", tmp, w, h);
+#else
+        printf("[%s] Rendered %ux%u preview. (%'lu μs)\n", tmp, w, h, microtime()-st);
+#endif
+        const uint r = writeImage(preview_path, px, w, h);
+        free(px);
+        timestamp(tmp);
+        if(r == 0){printf("[%s] Failed to write: %s\n", tmp, preview_path); return 1;}
+        printf("[%s] Saved preview: %s\n", tmp, preview_path);
+        return 0;
+    }
+
+    // render views around the model and quit, the volume is uploaded once
+    if(turntable_path[0] != 0x00)
+    {
+        const uint views = argc >= 5 ? atoi(argv[4]) : 8;
+        const uint w = argc >= 6 ? atoi(argv[5]) : 512;
+        const uint h = argc >= 7 ? atoi(argv[6]) : w;
+        const float elevation = argc >= 8 ? atof(argv[7]) : 30.f;
+        const float radius = argc >= 9 ? atof(argv[8]) : 240.f;
+        if(views < 1 || views > 1000){printf("ERROR: bad number of views %u.\n", views); return 1;}
+        if(w < 1 || h < 1 || w > 16384 || h > 16384){printf("ERROR: bad turntable size %ux%u.\n", w, h); return 1;}
+        return headlessTurntable(turntable_path, views, w, h, elevation, radius);
+    }
+
     // if this is just an export job then export and quit.
     if(export_path[0] != 0x00)
     {
-        if(export_type == 0){saveState(export_path, "", 1);}
-        if(export_type == 1)
-        {
-            FILE* f = fopen(export_path, "w");
-            if(f != NULL)
-            {
-                fprintf(f, "# %s %s\n", appTitle, appVersion);
-                fprintf(f, "# X Y Z RRGGBB\n");
-                for(uchar z = 0; z < 128; z++)
-                {
-                    for(uchar y = 0; y < 128; y++)
-                    {
-                        for(uchar x = 0; x < 128; x++)
-                        {
-                            const uint i = PTI(x,y,z);
-                            if(g.voxels[i] < 8){continue;}
-                            const uint tu = g.colors[g.voxels[i]-1];
-                            uchar r = (tu & 0x00FF0000) >> 16;
-                            uchar gc = (tu & 0x0000FF00) >> 8;
-                            uchar b = (tu & 0x000000FF);
-                            if(r != 0 || gc != 0 || b != 0)
-                                fprintf(f, "%i %i %i %02X%02X%02X\n", ((int)x)-64, ((int)y)-64, z, r, gc, b);
-                        }
-                    }
-                }
-                fclose(f);
-                char tmp[16];
-                timestamp(tmp);
-                printf("[%s] Exported TXT: %s\n", tmp, export_path);
-            }
-        }
-        if(export_type == 2)
+        if(lod_levels > 0)
         {
-            FILE* f = fopen(export_path, "w");
-            if(f != NULL)
+            if(exportLOD(&g, export_type, export_path, lod_levels, lod_threshold) == 1)
             {
-                fprintf(f, "# %s %s - Visible Voxels only\n", appTitle, appVersion);
-                fprintf(f, "# X Y Z RRGGBB\n");
-                for(uchar z = 0; z < 128; z++)
-                {
-                    for(uchar y = 0; y < 128; y++)
-                    {
-                        for(uchar x = 0; x < 128; x++)
-                        {
-                            const uint i = PTI(x,y,z);
-                            if(g.voxels[i] < 8){continue;}
-                            const uint tu = g.colors[g.voxels[i]-1];
-                            uchar r = (tu & 0x00FF0000) >> 16;
-                            uchar gc = (tu & 0x0000FF00) >> 8;
-                            uchar b = (tu & 0x000000FF);
-                            if(r != 0 || gc != 0 || b != 0)
-                            {
-                                if( x <=   0 || y <=   0 || z <=   0 ||
-                                    x >= 127 || y >= 127 || z >= 127 ||
-                                    g.voxels[PTIB(x-1, y, z)] == 0 ||
-                                    g.voxels[PTIB(x+1, y, z)] == 0 ||
-                                    g.voxels[PTIB(x, y-1, z)] == 0 ||
-                                    g.voxels[PTIB(x, y+1, z)] == 0 ||
-                                    g.voxels[PTIB(x, y, z-1)] == 0 ||
-                                    g.voxels[PTIB(x, y, z+1)] == 0 )
-                                {
-                                    fprintf(f, "%i %i %i %02X%02X%02X\n", ((int)x)-64, ((int)y)-64, z, r, gc, b);
-                                }
-                            }
-                        }
-                    }
-                }
-                fclose(f);
                 char tmp[16];
                 timestamp(tmp);
-                printf("[%s] Exported VV: %s\n", tmp, export_path);
+                printf("[%s] Exported %s LOD chain: %s\n", tmp, export_labels[export_type], export_path);
             }
         }
-        if(export_type == 3)
+        else if(export_type == EXPORT_WOX && exportFD(export_path) < 0){saveState(export_path, "", 1);}
+        else if(exportState(&g, NULL, export_type, export_path) == 1)
         {
-            FILE* f = fopen(export_path, "w");
-            if(f != NULL)
-            {
-                // I should be doing this in the single loop writing to memory so
-                // that I can append the header later for writing to file.
-                uint vc = 0;
-                for(uchar z = 0; z < 128; z++){
-                    for(uchar y = 0; y < 128; y++){
-                        for(uchar x = 0; x < 128; x++){
-                            const uint i = PTI(x,y,z);
-                            if(g.voxels[i] < 8){continue;}
-                            const uint tu = g.colors[g.voxels[i]-1];
-                            uchar cr = (tu & 0x00FF0000) >> 16;
-                            uchar cg = (tu & 0x0000FF00) >> 8;
-                            uchar cb = (tu & 0x000000FF);
-                            if(cr != 0 || cg != 0 || cb != 0)
-                            {
-                                int r = PTIB2(x-1, y, z);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                                r = PTIB2(x+1, y, z);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                                r = PTIB2(x, y-1, z);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                                r = PTIB2(x, y+1, z);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                                r = PTIB2(x, y, z-1);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                                r = PTIB2(x, y, z+1);
-                                if(r < 0 || g.voxels[r] == 0){vc+=6;}
-                }}}}
-                // but it's unlikely to ever be that expensive that anyone would notice this inefficiency
-                fprintf(f, "ply\n");
-                fprintf(f, "format ascii 1.0\n");
-                fprintf(f, "comment Created by %s %s - woxels.github.io\n", appTitle, appVersion);
-                fprintf(f, "element vertex %u\n", vc);
-                fprintf(f, "property float x\n");
-                fprintf(f, "property float y\n");
-                fprintf(f, "property float z\n");
-                fprintf(f, "property float nx\n");
-                fprintf(f, "property float ny\n");
-                fprintf(f, "property float nz\n");
-                fprintf(f, "property uchar red\n");
-                fprintf(f, "property uchar green\n");
-                fprintf(f, "property uchar blue\n");
-                const uint faces = vc/3;
-                fprintf(f, "element face %u\n", faces);
-                fprintf(f, "property list uchar uint vertex_indices\n");
-                fprintf(f, "end_header\n");
-                for(uchar z = 0; z < 128; z++)
-                {
-                    for(uchar y = 0; y < 128; y++)
-                    {
-                        for(uchar x = 0; x < 128; x++)
-                        {
-                            const uint i = PTI(x,y,z);
-                            if(g.voxels[i] < 8){continue;}
-                            const uint tu = g.colors[g.voxels[i]-1];
-                            uchar cr = (tu & 0x00FF0000) >> 16;
-                            uchar cg = (tu & 0x0000FF00) >> 8;
-                            uchar cb = (tu & 0x000000FF);
-                            if(cr != 0 || cg != 0 || cb != 0)
-                            {
-                                int r = PTIB2(x-1, y, z);
-                                if(r < 0 || g.voxels[r] == 0){fw_mx(f, x, y, z, cr, cg, cb);}
-                                r = PTIB2(x+1, y, z);
-                                if(r < 0 || g.voxels[r] == 0){fw_px(f, x, y, z, cr, cg, cb);}
-                                r = PTIB2(x, y-1, z);
-                                if(r < 0 || g.voxels[r] == 0){fw_my(f, x, y, z, cr, cg, cb);}
-                                r = PTIB2(x, y+1, z);
-                                if(r < 0 || g.voxels[r] == 0){fw_py(f, x, y, z, cr, cg, cb);}
-                                r = PTIB2(x, y, z-1);
-                                if(r < 0 || g.voxels[r] == 0){fw_mz(f, x, y, z, cr, cg, cb);}
-                                r = PTIB2(x, y, z+1);
-                                if(r < 0 || g.voxels[r] == 0){fw_pz(f, x, y, z, cr, cg, cb);}
-                            }
-                        }
-                    }
-                }
-                // merge vertices by distance in Blender or `Cleaning and Repairing > Merge Close Vertices` in MeshLab
-                for(int i = 0, t = 0; i < faces; i++)
-                {
-                    const int i1 = t++;
-                    const int i2 = t++;
-                    const int i3 = t++;
-                    fprintf(f, "3 %i %i %i\n", i1, i2, i3);
-                }
-                fclose(f);
-                char tmp[16];
-                timestamp(tmp);
-                printf("[%s] Exported PLY: %s\n", tmp, export_path);
-            }
+            char tmp[16];
+            timestamp(tmp);
+            printf("[%s] Exported %s: %s\n", tmp, export_labels[export_type], export_path);
         }
         return 0;
     }
 
     // custom mouse sensitivity
-    if(argc >= 3)
+    if(bench == 0 && argc >= 3)
     {
         g.sens = atof(argv[2]);
         if(g.sens == 0.f){g.sens = 0.003f;}
@@ -1596,7 +1705,7 @@ int main(int argc, char** argv)
     }
 
     // load custom palette
-    if(argc >= 4){loadColors(argv[3]);}
+    if(bench == 0 && argc >= 4){loadColors(argv[3]);}
 
 //*************************************
 // window creation
@@ -1647,6 +1756,7 @@ int main(int argc, char** argv)
             wnd = SDL_CreateWindow(appTitle, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, winw, winh, SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
         }
     }
+    SDL_SetWindowMinimumSize(wnd, 401, 411); // the help panel fits, same as the decor resize
     SDL_GL_SetSwapInterval(1);
     glc = SDL_GL_CreateContext(wnd);
     if(glc == NULL)
@@ -1721,7 +1831,7 @@ int main(int argc, char** argv)
 // projection & compile & link shader program
 //*************************************
     makeHud();
-    shadeHud(&position_id, &hud_id, &look_pos_id, &scale_id, &view_id, &voxel_id);
+    shadeHud(&position_id, &hud_id, &look_pos_id, &scale_id, &pixel_id, &view_id, &voxel_id);
     glUniform2f(scale_id, xscale, yscale);
     glBindBuffer(GL_ARRAY_BUFFER, mdlPlane.vid);
     glVertexAttribPointer(position_id, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -1735,26 +1845,34 @@ int main(int argc, char** argv)
     glDisable(GL_DEPTH_TEST);
     glLineWidth(0.f);
     glClearColor(0.f, 0.f, 0.f, 0.f);
+    gpuTimerInit(argc >= 2 && strcmp(argv[1], "debug") == 0);
+    if(gpu_mode != GPU_OFF)
+    {
+        char tmp[16];
+        timestamp(tmp);
+        printf("[%s] GPU timer: %s\n", tmp, gpu_names[gpu_mode]);
+    }
 
 //*************************************
 // final init stuff
 //*************************************
     sVoxel = SDL_RGBA32Surface(1024, 2048);
-    for (int x = 0; x < 1024; x++)
-    for (int y = 0; y < 2048; y++) {
-        int index = (x * 2048) + y;
-        if (g.voxels[index] < 1) {
-	    setpixel(sVoxel, x, y, 0x00000000);
-        } else {
-            uint32_t color = g.colors[g.voxels[index]-1];
-            color = (color >> 16) | (((color >> 8) & 0xFF) << 8) | ((color & 0xFF) << 16) | (0xFF << 24);
-            setpixel(sVoxel, x, y, color);
-        }
-    }
+    updateVoxelSurface();
     voxelmap = esLoadTextureA(1024, 2048, sVoxel->pixels, 0);
+    undoReset();
     flipHud();
     updateSelectColor();
 
+    // benchmark and quit, nothing is saved
+    if(bench == 1)
+    {
+        const int r = benchRun(argc >= 4 ? argv[3] : NULL, argc >= 5 ? atoi(argv[4]) : 0, argc >= 6 ? argv[5] : BENCH_SIZES);
+        SDL_GL_DeleteContext(glc);
+        SDL_DestroyWindow(wnd);
+        SDL_Quit();
+        return r;
+    }
+
 //*************************************
 // execute update / render loop
 //*************************************